@@ -26,6 +26,7 @@
 	#include <arpa/inet.h>
 
 	#include <dirent.h>
+	#include <sys/mman.h>
 
 	#if defined(CONF_PLATFORM_MACOSX)
 		#include <Carbon/Carbon.h>
@@ -295,6 +296,8 @@ IOHANDLE io_open(const char *filename, int flags)
 	}
 	if(flags == IOFLAG_WRITE)
 		return (IOHANDLE)fopen(filename, "wb");
+	if(flags == IOFLAG_APPEND)
+		return (IOHANDLE)fopen(filename, "ab");
 	return 0x0;
 }
 
@@ -361,14 +364,36 @@ unsigned io_write_newline(IOHANDLE io)
 
 int io_close(IOHANDLE io)
 {
-	fclose((FILE*)io);
-	return 1;
+	return fclose((FILE*)io) != 0;
 }
 
 int io_flush(IOHANDLE io)
 {
-	fflush((FILE*)io);
-	return 0;
+	return fflush((FILE*)io);
+}
+
+void *io_map(IOHANDLE io, unsigned size)
+{
+#if defined(CONF_FAMILY_UNIX)
+	void *data;
+	if(!size)
+		return 0x0;
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno((FILE*)io), 0);
+	if(data == MAP_FAILED)
+		return 0x0;
+	return data;
+#else
+	/* mapped files can't be replaced on windows, let the caller read them instead */
+	return 0x0;
+#endif
+}
+
+void io_unmap(void *data, unsigned size)
+{
+#if defined(CONF_FAMILY_UNIX)
+	if(data)
+		munmap(data, size);
+#endif
 }
 
 void *thread_init(void (*threadfunc)(void *), void *u)
@@ -508,22 +533,109 @@ void lock_unlock(LOCK lock)
 #endif
 }
 
-#if !defined(CONF_PLATFORM_MACOSX)
-	#if defined(CONF_FAMILY_UNIX)
-	void semaphore_init(SEMAPHORE *sem) { sem_init(sem, 0, 0); }
-	void semaphore_wait(SEMAPHORE *sem) { sem_wait(sem); }
-	void semaphore_signal(SEMAPHORE *sem) { sem_post(sem); }
-	void semaphore_destroy(SEMAPHORE *sem) { sem_destroy(sem); }
-	#elif defined(CONF_FAMILY_WINDOWS)
-	void semaphore_init(SEMAPHORE *sem) { *sem = CreateSemaphore(0, 0, 10000, 0); }
-	void semaphore_wait(SEMAPHORE *sem) { WaitForSingleObject((HANDLE)*sem, INFINITE); }
-	void semaphore_signal(SEMAPHORE *sem) { ReleaseSemaphore((HANDLE)*sem, 1, NULL); }
-	void semaphore_destroy(SEMAPHORE *sem) { CloseHandle((HANDLE)*sem); }
-	#else
-		#error not implemented on this platform
-	#endif
+#if defined(CONF_PLATFORM_MACOSX)
+void semaphore_init(SEMAPHORE *sem)
+{
+	pthread_mutex_init(&sem->mutex, NULL);
+	pthread_cond_init(&sem->cond, NULL);
+	sem->count = 0;
+}
+
+void semaphore_wait(SEMAPHORE *sem)
+{
+	pthread_mutex_lock(&sem->mutex);
+	while(sem->count == 0)
+		pthread_cond_wait(&sem->cond, &sem->mutex);
+	sem->count--;
+	pthread_mutex_unlock(&sem->mutex);
+}
+
+void semaphore_signal(SEMAPHORE *sem)
+{
+	pthread_mutex_lock(&sem->mutex);
+	sem->count++;
+	pthread_cond_signal(&sem->cond);
+	pthread_mutex_unlock(&sem->mutex);
+}
+
+void semaphore_destroy(SEMAPHORE *sem)
+{
+	pthread_cond_destroy(&sem->cond);
+	pthread_mutex_destroy(&sem->mutex);
+}
+
+int semaphore_wait_timeout(SEMAPHORE *sem, int ms)
+{
+	struct timeval now;
+	struct timespec until;
+	int signaled = 0;
+
+	gettimeofday(&now, NULL);
+	until.tv_sec = now.tv_sec + ms/1000;
+	until.tv_nsec = now.tv_usec*1000 + (ms%1000)*1000000;
+	if(until.tv_nsec >= 1000000000)
+	{
+		until.tv_sec++;
+		until.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&sem->mutex);
+	while(sem->count == 0)
+	{
+		if(pthread_cond_timedwait(&sem->cond, &sem->mutex, &until) != 0)
+			break;
+	}
+	if(sem->count > 0)
+	{
+		sem->count--;
+		signaled = 1;
+	}
+	pthread_mutex_unlock(&sem->mutex);
+	return signaled;
+}
+#elif defined(CONF_FAMILY_UNIX)
+void semaphore_init(SEMAPHORE *sem) { sem_init(sem, 0, 0); }
+void semaphore_wait(SEMAPHORE *sem) { sem_wait(sem); }
+void semaphore_signal(SEMAPHORE *sem) { sem_post(sem); }
+void semaphore_destroy(SEMAPHORE *sem) { sem_destroy(sem); }
+
+int semaphore_wait_timeout(SEMAPHORE *sem, int ms)
+{
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec += ms/1000;
+	until.tv_nsec += (ms%1000)*1000000;
+	if(until.tv_nsec >= 1000000000)
+	{
+		until.tv_sec++;
+		until.tv_nsec -= 1000000000;
+	}
+	while(sem_timedwait(sem, &until) != 0)
+	{
+		if(errno != EINTR)
+			return 0;
+	}
+	return 1;
+}
+#elif defined(CONF_FAMILY_WINDOWS)
+void semaphore_init(SEMAPHORE *sem) { *sem = CreateSemaphore(0, 0, 10000, 0); }
+void semaphore_wait(SEMAPHORE *sem) { WaitForSingleObject((HANDLE)*sem, INFINITE); }
+void semaphore_signal(SEMAPHORE *sem) { ReleaseSemaphore((HANDLE)*sem, 1, NULL); }
+void semaphore_destroy(SEMAPHORE *sem) { CloseHandle((HANDLE)*sem); }
+int semaphore_wait_timeout(SEMAPHORE *sem, int ms) { return WaitForSingleObject((HANDLE)*sem, ms) == WAIT_OBJECT_0; }
+#else
+	#error not implemented on this platform
 #endif
 
+void sync_barrier()
+{
+#if defined(_MSC_VER)
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+}
+
 
 /* -----  time ----- */
 int64 time_get()
@@ -853,7 +965,7 @@ static int priv_net_close_all_sockets(NETSOCKET sock)
 	return 0;
 }
 
-static int priv_net_create_socket(int domain, int type, struct sockaddr *addr, int sockaddrlen, int use_random_port)
+static int priv_net_create_socket(int domain, int type, struct sockaddr *addr, int sockaddrlen, int use_random_port, int reuse_port)
 {
 	int sock, e;
 
@@ -882,6 +994,18 @@ static int priv_net_create_socket(int domain, int type, struct sockaddr *addr, i
 	}
 #endif
 
+	/* let several processes share the port, the kernel spreads the peers over them */
+	if(reuse_port)
+	{
+#if defined(SO_REUSEPORT)
+		int reuse = 1;
+		if(setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (const char*)&reuse, sizeof(reuse)) != 0)
+			dbg_msg("net", "failed to set SO_REUSEPORT (%d '%s')", errno, strerror(errno));
+#else
+		dbg_msg("net", "SO_REUSEPORT is not supported on this platform");
+#endif
+	}
+
 	/* bind the socket */
 	while(1)
 	{
@@ -922,7 +1046,7 @@ static int priv_net_create_socket(int domain, int type, struct sockaddr *addr, i
 	return sock;
 }
 
-NETSOCKET net_udp_create(NETADDR bindaddr, int use_random_port)
+static NETSOCKET priv_net_udp_create(NETADDR bindaddr, int use_random_port, int reuse_port)
 {
 	NETSOCKET sock = invalid_socket;
 	NETADDR tmpbindaddr = bindaddr;
@@ -937,7 +1061,7 @@ NETSOCKET net_udp_create(NETADDR bindaddr, int use_random_port)
 		/* bind, we should check for error */
 		tmpbindaddr.type = NETTYPE_IPV4;
 		netaddr_to_sockaddr_in(&tmpbindaddr, &addr);
-		socket = priv_net_create_socket(AF_INET, SOCK_DGRAM, (struct sockaddr *)&addr, sizeof(addr), use_random_port);
+		socket = priv_net_create_socket(AF_INET, SOCK_DGRAM, (struct sockaddr *)&addr, sizeof(addr), use_random_port, reuse_port);
 		if(socket >= 0)
 		{
 			sock.type |= NETTYPE_IPV4;
@@ -959,7 +1083,7 @@ NETSOCKET net_udp_create(NETADDR bindaddr, int use_random_port)
 		/* bind, we should check for error */
 		tmpbindaddr.type = NETTYPE_IPV6;
 		netaddr_to_sockaddr_in6(&tmpbindaddr, &addr);
-		socket = priv_net_create_socket(AF_INET6, SOCK_DGRAM, (struct sockaddr *)&addr, sizeof(addr), use_random_port);
+		socket = priv_net_create_socket(AF_INET6, SOCK_DGRAM, (struct sockaddr *)&addr, sizeof(addr), use_random_port, reuse_port);
 		if(socket >= 0)
 		{
 			sock.type |= NETTYPE_IPV6;
@@ -980,6 +1104,16 @@ NETSOCKET net_udp_create(NETADDR bindaddr, int use_random_port)
 	return sock;
 }
 
+NETSOCKET net_udp_create(NETADDR bindaddr, int use_random_port)
+{
+	return priv_net_udp_create(bindaddr, use_random_port, 0);
+}
+
+NETSOCKET net_udp_create_shared(NETADDR bindaddr)
+{
+	return priv_net_udp_create(bindaddr, 0, 1);
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
@@ -1096,7 +1230,7 @@ NETSOCKET net_tcp_create(NETADDR bindaddr)
 		/* bind, we should check for error */
 		tmpbindaddr.type = NETTYPE_IPV4;
 		netaddr_to_sockaddr_in(&tmpbindaddr, &addr);
-		socket = priv_net_create_socket(AF_INET, SOCK_STREAM, (struct sockaddr *)&addr, sizeof(addr), 0);
+		socket = priv_net_create_socket(AF_INET, SOCK_STREAM, (struct sockaddr *)&addr, sizeof(addr), 0, 0);
 		if(socket >= 0)
 		{
 			sock.type |= NETTYPE_IPV4;
@@ -1112,7 +1246,7 @@ NETSOCKET net_tcp_create(NETADDR bindaddr)
 		/* bind, we should check for error */
 		tmpbindaddr.type = NETTYPE_IPV6;
 		netaddr_to_sockaddr_in6(&tmpbindaddr, &addr);
-		socket = priv_net_create_socket(AF_INET6, SOCK_STREAM, (struct sockaddr *)&addr, sizeof(addr), 0);
+		socket = priv_net_create_socket(AF_INET6, SOCK_STREAM, (struct sockaddr *)&addr, sizeof(addr), 0, 0);
 		if(socket >= 0)
 		{
 			sock.type |= NETTYPE_IPV6;
@@ -183,6 +183,7 @@ enum {
 	IOFLAG_READ = 1,
 	IOFLAG_WRITE = 2,
 	IOFLAG_RANDOM = 4,
+	IOFLAG_APPEND = 8,
 
 	IOSEEK_START = 0,
 	IOSEEK_CUR = 1,
@@ -197,7 +198,7 @@ typedef struct IOINTERNAL *IOHANDLE;
 
 	Parameters:
 		filename - File to open.
-		flags - A set of flags. IOFLAG_READ, IOFLAG_WRITE, IOFLAG_RANDOM.
+		flags - A set of flags. IOFLAG_READ, IOFLAG_WRITE, IOFLAG_RANDOM, IOFLAG_APPEND.
 
 	Returns:
 		Returns a handle to the file on success and 0 on failure.
@@ -321,6 +322,35 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
+/*
+	Function: io_map
+		Maps the contents of a file read-only into memory.
+
+	Parameters:
+		io - Handle to the file.
+		size - Number of bytes to map, usually the length of the file.
+
+	Returns:
+		Returns a pointer to the mapped data or 0 if the file
+		couldn't be mapped. The mapping stays valid after the
+		file has been closed and must be released with <io_unmap>.
+
+	Remarks:
+		Not available on all platforms, callers should fall back
+		to <io_read> when 0 is returned.
+*/
+void *io_map(IOHANDLE io, unsigned size);
+
+/*
+	Function: io_unmap
+		Releases a mapping created by <io_map>.
+
+	Parameters:
+		data - Pointer returned by <io_map>.
+		size - Number of bytes that were mapped.
+*/
+void io_unmap(void *data, unsigned size);
+
 
 /*
 	Function: io_stdin
@@ -411,22 +441,50 @@ void lock_unlock(LOCK lock);
 
 /* Group: Semaphores */
 
-#if !defined(CONF_PLATFORM_MACOSX)
-	#if defined(CONF_FAMILY_UNIX)
-		#include <semaphore.h>
-		typedef sem_t SEMAPHORE;
-	#elif defined(CONF_FAMILY_WINDOWS)
-		typedef void* SEMAPHORE;
-	#else
-		#error missing sempahore implementation
-	#endif
-
-	void semaphore_init(SEMAPHORE *sem);
-	void semaphore_wait(SEMAPHORE *sem);
-	void semaphore_signal(SEMAPHORE *sem);
-	void semaphore_destroy(SEMAPHORE *sem);
+#if defined(CONF_PLATFORM_MACOSX)
+	/* unnamed posix semaphores aren't supported on mac os x */
+	#include <pthread.h>
+	typedef struct
+	{
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		int count;
+	} SEMAPHORE;
+#elif defined(CONF_FAMILY_UNIX)
+	#include <semaphore.h>
+	typedef sem_t SEMAPHORE;
+#elif defined(CONF_FAMILY_WINDOWS)
+	typedef void* SEMAPHORE;
+#else
+	#error missing sempahore implementation
 #endif
 
+void semaphore_init(SEMAPHORE *sem);
+void semaphore_wait(SEMAPHORE *sem);
+void semaphore_signal(SEMAPHORE *sem);
+void semaphore_destroy(SEMAPHORE *sem);
+
+/*
+	Function: semaphore_wait_timeout
+		Waits for the semaphore, but gives up after a while.
+
+	Parameters:
+		sem - Semaphore to wait for.
+		ms - Milliseconds to wait at most.
+
+	Returns:
+		1 if the semaphore was signaled, 0 on timeout.
+*/
+int semaphore_wait_timeout(SEMAPHORE *sem, int ms);
+
+/*
+	Function: sync_barrier
+		Full memory barrier. Orders the memory accesses before it
+		against the ones after it, for lock-free data shared between
+		threads.
+*/
+void sync_barrier();
+
 /* Group: Timer */
 #ifdef __GNUC__
 /* if compiled with -pedantic-errors it will complain about long
@@ -575,6 +633,21 @@ int net_addr_from_str(NETADDR *addr, const char *string);
 */
 NETSOCKET net_udp_create(NETADDR bindaddr, int use_random_port);
 
+/*
+	Function: net_udp_create_shared
+		Creates a UDP socket bound to a port that other processes may
+		bind as well (SO_REUSEPORT). The kernel keeps each peer on the
+		same socket.
+
+	Parameters:
+		bindaddr - Address to bind the socket to.
+
+	Returns:
+		On success it returns an handle to the socket. On failure it
+		returns NETSOCKET_INVALID.
+*/
+NETSOCKET net_udp_create_shared(NETADDR bindaddr);
+
 /*
 	Function: net_udp_send
 		Sends a packet over an UDP socket.
@@ -25,8 +25,10 @@ protected:
 public:
 	virtual void Init() = 0;
 	virtual void InitLogfile() = 0;
+	virtual void InitJobs() = 0;
 	virtual void HostLookup(CHostLookup *pLookup, const char *pHostname, int Nettype) = 0;
 	virtual void AddJob(CJob *pJob, JOBFUNC pfnFunc, void *pData) = 0;
+	CJobPool *JobPool() { return &m_JobPool; }
 };
 
 extern IEngine *CreateEngine(const char *pAppname);
@@ -26,9 +26,12 @@ class IEngineMap : public IMap
 	MACRO_INTERFACE("enginemap", 0)
 public:
 	virtual bool Load(const char *pMapName) = 0;
+	virtual bool LoadFromMemory(unsigned char *pData, unsigned Size) = 0; // takes ownership of pData
 	virtual bool IsLoaded() = 0;
 	virtual void Unload() = 0;
 	virtual unsigned Crc() = 0;
+	virtual const unsigned char *FileData() = 0;
+	virtual unsigned FileSize() = 0;
 };
 
 extern IEngineMap *CreateEngineMap();
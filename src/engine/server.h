@@ -32,6 +32,10 @@ public:
 		const char *m_pName;
 		int m_Latency;
 		bool m_CustClt;
+
+		// inputs that arrived after their tick, and ones that were never applied
+		int m_InputsLate;
+		int m_InputsDropped;
 	};
 
 	inline class CLocalization* Localization() { return m_pLocalization; }
@@ -52,19 +56,49 @@ public:
 	template<class T>
 	int SendPackMsg(T *pMsg, int Flags, int ClientID)
 	{
-		int result = 0;
+		if(ClientID == -1)
+			return SendPackMsgBroadcast(pMsg, Flags);
+
 		T tmp;
-		if (ClientID == -1)
+		mem_copy(&tmp, pMsg, sizeof(T));
+		return SendPackMsgTranslate(&tmp, Flags, ClientID);
+	}
+
+	// translates the ids for every recipient, then packs each distinct
+	// result once and sends the same bytes to everyone sharing it
+	template<class T>
+	int SendPackMsgBroadcast(T *pMsg, int Flags)
+	{
+		int result = 0;
+		T aTranslated[MAX_CLIENTS];
+		bool aPending[MAX_CLIENTS];
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			aPending[i] = false;
+			if(!ClientIngame(i))
+				continue;
+			mem_copy(&aTranslated[i], pMsg, sizeof(T));
+			aPending[i] = TranslateMsg(&aTranslated[i], i);
+		}
+
+		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
-			for(int i = 0; i < MAX_CLIENTS; i++)
-				if(ClientIngame(i))
-				{
-					mem_copy(&tmp, pMsg, sizeof(T));
-					result = SendPackMsgTranslate(&tmp, Flags, i);
-				}
-		} else {
-			mem_copy(&tmp, pMsg, sizeof(T));
-			result = SendPackMsgTranslate(&tmp, Flags, ClientID);
+			if(!aPending[i])
+				continue;
+
+			CMsgPacker Packer(aTranslated[i].MsgID());
+			if(aTranslated[i].Pack(&Packer))
+				return -1;
+
+			for(int j = i; j < MAX_CLIENTS; j++)
+			{
+				if(!aPending[j] || (j != i && mem_comp(&aTranslated[j], &aTranslated[i], sizeof(T)) != 0))
+					continue;
+				aPending[j] = false;
+				result = SendMsg(&Packer, Flags, j);
+				// the demo only needs the message once
+				Flags |= MSGFLAG_NORECORD;
+			}
 		}
 		return result;
 	}
@@ -72,17 +106,26 @@ public:
 	template<class T>
 	int SendPackMsgTranslate(T *pMsg, int Flags, int ClientID)
 	{
+		if(!TranslateMsg(pMsg, ClientID))
+			return 0;
 		return SendPackMsgOne(pMsg, Flags, ClientID);
 	}
 
-	int SendPackMsgTranslate(CNetMsg_Sv_Emoticon *pMsg, int Flags, int ClientID)
+	// rewrites the client ids for ClientID's view, false if it must not get the message
+	template<class T>
+	bool TranslateMsg(T *pMsg, int ClientID)
+	{
+		return true;
+	}
+
+	bool TranslateMsg(CNetMsg_Sv_Emoticon *pMsg, int ClientID)
 	{
-		return Translate(pMsg->m_ClientID, ClientID) && SendPackMsgOne(pMsg, Flags, ClientID);
+		return Translate(pMsg->m_ClientID, ClientID);
 	}
 
 	char msgbuf[1000];
 
-	int SendPackMsgTranslate(CNetMsg_Sv_Chat *pMsg, int Flags, int ClientID)
+	bool TranslateMsg(CNetMsg_Sv_Chat *pMsg, int ClientID)
 	{
 		if (pMsg->m_ClientID >= 0 && !Translate(pMsg->m_ClientID, ClientID))
 		{
@@ -90,14 +133,14 @@ public:
 			pMsg->m_pMessage = msgbuf;
 			pMsg->m_ClientID = VANILLA_MAX_CLIENTS - 1;
 		}
-		return SendPackMsgOne(pMsg, Flags, ClientID);
+		return true;
 	}
 
-	int SendPackMsgTranslate(CNetMsg_Sv_KillMsg *pMsg, int Flags, int ClientID)
+	bool TranslateMsg(CNetMsg_Sv_KillMsg *pMsg, int ClientID)
 	{
-		if (!Translate(pMsg->m_Victim, ClientID)) return 0;
+		if (!Translate(pMsg->m_Victim, ClientID)) return false;
 		if (!Translate(pMsg->m_Killer, ClientID)) pMsg->m_Killer = pMsg->m_Victim;
-		return SendPackMsgOne(pMsg, Flags, ClientID);
+		return true;
 	}
 
 	template<class T>
@@ -171,11 +214,15 @@ public:
 	virtual void SetCustClt(int ClientID) = 0;
 
 	virtual void AddZombie() = 0;
+	// 0 while the client isn't in game yet
 	virtual class CPlayerData *GetPlayerData(int ClientID, int ColorID) = 0;
+	virtual bool SavePlayerData(class CPlayerData *pData) = 0;
 	virtual int GetHighScore() = 0;
 	virtual int GetPlayerCount() = 0;
 
 	virtual char *GetMapName() = 0;
+	// hands a finished map image (mem_alloc'd, ownership is taken) to the server, it is used the next time pMapName gets loaded
+	virtual void SetGeneratedMap(const char *pMapName, unsigned char *pData, unsigned Size, bool SaveToDisk) = 0;
 	bool m_MapGenerated; // MapGen
 };
 
@@ -287,3 +287,11 @@ int CRegister::RegisterProcessPacket(CNetChunk *pPacket)
 
 	return 0;
 }
+
+bool CRegister::IsRegisterPacket(const CNetChunk *pPacket)
+{
+	return (pPacket->m_DataSize == sizeof(SERVERBROWSE_FWCHECK) && mem_comp(pPacket->m_pData, SERVERBROWSE_FWCHECK, sizeof(SERVERBROWSE_FWCHECK)) == 0) ||
+		(pPacket->m_DataSize == sizeof(SERVERBROWSE_FWOK) && mem_comp(pPacket->m_pData, SERVERBROWSE_FWOK, sizeof(SERVERBROWSE_FWOK)) == 0) ||
+		(pPacket->m_DataSize == sizeof(SERVERBROWSE_FWERROR) && mem_comp(pPacket->m_pData, SERVERBROWSE_FWERROR, sizeof(SERVERBROWSE_FWERROR)) == 0) ||
+		(pPacket->m_DataSize == sizeof(SERVERBROWSE_COUNT)+2 && mem_comp(pPacket->m_pData, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT)) == 0);
+}
@@ -46,6 +46,9 @@ public:
 	void Init(class CNetServer *pNetServer, class IEngineMasterServer *pMasterServer, class IConsole *pConsole);
 	void RegisterUpdate(int Nettype);
 	int RegisterProcessPacket(struct CNetChunk *pPacket);
+
+	// whether the packet is part of the master server handshake
+	static bool IsRegisterPacket(const struct CNetChunk *pPacket);
 };
 
 #endif
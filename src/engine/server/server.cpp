@@ -27,7 +27,10 @@
 
 #include <mastersrv/mastersrv.h>
 
+#include <game/server/playerdata.h>
+
 #include "register.h"
+#include "shard.h"
 #include "server.h"
 
 #include <teeuniverses/components/localization.h>
@@ -265,15 +268,25 @@ void CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 void CServer::CClient::Reset()
 {
 	// reset input
-	for(int i = 0; i < 200; i++)
+	for(int i = 0; i < INPUT_RING_SIZE; i++)
 		m_aInputs[i].m_GameTick = -1;
-	m_CurrentInput = 0;
+	m_NumInputs = 0;
+	m_NumInputsLate = 0;
+	m_NumInputsDropped = 0;
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
 
 	m_Snapshots.PurgeAll();
 	m_LastAckedSnapshot = -1;
 	m_LastInputTick = -1;
 	m_SnapRate = CClient::SNAPRATE_INIT;
+	m_SnapInterval = 1;
+	m_LastSnapTick = -1;
+	m_SnapWindowSent = 0;
+	m_SnapWindowAcked = 0;
+	m_SnapWindowBytes = 0;
+	m_LastCountedAck = -1;
+	m_LastResends = 0;
+	m_SnapLoss = 0;
 	m_Score = 0;
 	str_copy(m_aLanguage, "en", sizeof(m_aLanguage));
 }
@@ -293,12 +306,18 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_TickSpeed = SERVER_TICK_SPEED;
 
 	m_pGameServer = 0;
+	m_pPlayerData = 0;
 
 	m_CurrentGameTick = 0;
 	m_RunServer = 1;
 
 	m_pCurrentMapData = 0;
 	m_CurrentMapSize = 0;
+	m_CurrentMapInMemory = false;
+
+	m_aPendingMap[0] = 0;
+	m_pPendingMapData = 0;
+	m_PendingMapSize = 0;
 
 	m_MapReload = 0;
 
@@ -308,6 +327,12 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_ServerInfoFirstRequest = 0;
 	m_ServerInfoNumRequests = 0;
 	m_ServerInfoHighLoad = false;
+	m_ServerInfoVersion = 0;
+	m_ServerInfoCheckTick = -1;
+	m_ServerInfoSpectatorSlots = -1;
+	mem_zero(m_aServerInfoClientState, sizeof(m_aServerInfoClientState));
+	for(int i = 0; i < (int)(sizeof(m_aServerInfoCache)/sizeof(m_aServerInfoCache[0])); i++)
+		m_aServerInfoCache[i].m_Version = -1;
 
 	Init();
 }
@@ -344,6 +369,7 @@ int CServer::TrySetClientName(int ClientID, const char *pName)
 
 	// set the client name
 	str_copy(m_aClients[ClientID].m_aName, pName, MAX_NAME_LENGTH);
+	ExpireServerInfo();
 	return 0;
 }
 
@@ -378,6 +404,8 @@ void CServer::SetClientClan(int ClientID, const char *pClan)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY || !pClan)
 		return;
 
+	if(str_comp(m_aClients[ClientID].m_aClan, pClan) != 0)
+		ExpireServerInfo();
 	str_copy(m_aClients[ClientID].m_aClan, pClan, MAX_CLAN_LENGTH);
 }
 
@@ -386,6 +414,8 @@ void CServer::SetClientCountry(int ClientID, int Country)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
 
+	if(m_aClients[ClientID].m_Country != Country)
+		ExpireServerInfo();
 	m_aClients[ClientID].m_Country = Country;
 }
 
@@ -393,6 +423,8 @@ void CServer::SetClientScore(int ClientID, int Score)
 {
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
+	if(m_aClients[ClientID].m_Score != Score)
+		ExpireServerInfo();
 	m_aClients[ClientID].m_Score = Score;
 }
 
@@ -469,6 +501,8 @@ int CServer::GetClientInfo(int ClientID, CClientInfo *pInfo)
 		pInfo->m_pName = m_aClients[ClientID].m_aName;
 		pInfo->m_Latency = m_aClients[ClientID].m_Latency;
 		pInfo->m_CustClt = m_aClients[ClientID].m_CustClt;
+		pInfo->m_InputsLate = m_aClients[ClientID].m_NumInputsLate;
+		pInfo->m_InputsDropped = m_aClients[ClientID].m_NumInputsDropped;
 		return 1;
 	}
 	return 0;
@@ -540,6 +574,8 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 	Packet.m_DataSize = pMsg->Size();
 
 	// HACK: modify the message id in the packet and store the system flag
+	// the original byte is restored below so the packer can be sent again
+	unsigned char MsgID = *((unsigned char*)Packet.m_pData);
 	*((unsigned char*)Packet.m_pData) <<= 1;
 	if(System)
 		*((unsigned char*)Packet.m_pData) |= 1;
@@ -569,13 +605,71 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 		else
 			m_NetServer.Send(&Packet);
 	}
+
+	*((unsigned char*)Packet.m_pData) = MsgID;
 	return 0;
 }
 
+void CServer::UpdateSnapRates()
+{
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CClient *pClient = &m_aClients[i];
+		if(pClient->m_State != CClient::STATE_INGAME)
+			continue;
+
+		int Resends = m_NetServer.NumResends(i) - pClient->m_LastResends;
+		int Queue = m_NetServer.ResendQueueDepth(i);
+		int Sent = pClient->m_SnapWindowSent;
+		int AvgSize = Sent ? pClient->m_SnapWindowBytes/Sent : 0;
+		pClient->m_LastResends = m_NetServer.NumResends(i);
+
+		// snapshots the client never acked count as lost. long intervals send
+		// less than a window per second, keep collecting until it's full
+		if(Sent >= SNAP_LOSS_SAMPLES)
+		{
+			int Loss = 100 - min(pClient->m_SnapWindowAcked, Sent)*100/Sent;
+			pClient->m_SnapLoss = (pClient->m_SnapLoss*3 + Loss)/4;
+			pClient->m_SnapWindowSent = 0;
+			pClient->m_SnapWindowAcked = 0;
+			pClient->m_SnapWindowBytes = 0;
+		}
+
+		if(pClient->m_SnapRate != CClient::SNAPRATE_FULL)
+			continue;
+
+		int Interval = pClient->m_SnapInterval;
+		if(!g_Config.m_SvSnapAdaptive)
+			Interval = 1;
+		else if(pClient->m_SnapLoss > 15 || Queue > 32 || Resends > 10 || pClient->m_Latency > 400)
+		{
+			// big multi packet snapshots on a bad link hurt the most, back off faster
+			Interval += AvgSize > MAX_SNAPSHOT_PACKSIZE ? 2 : 1;
+		}
+		else if(pClient->m_SnapLoss < 5 && Queue < 8 && Resends < 3 && pClient->m_Latency < 250)
+			Interval--;
+		Interval = clamp(Interval, 1, g_Config.m_SvSnapIntervalMax);
+
+		if(Interval != pClient->m_SnapInterval)
+		{
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "ClientID=%d interval=%d->%d rtt=%d loss=%d%% resends=%d queue=%d size=%d",
+				i, pClient->m_SnapInterval, Interval, pClient->m_Latency, pClient->m_SnapLoss, Resends, Queue, AvgSize);
+			Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "snaprate", aBuf);
+			pClient->m_SnapInterval = Interval;
+		}
+	}
+}
+
 void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
 
+	// decide the snapshot rates once a second
+	if(Tick()%TickSpeed() == 0)
+		UpdateSnapRates();
+	int SnapPeriod = g_Config.m_SvHighBandwidth ? 1 : 2;
+
 	// create snapshot for demo recording
 	if(m_DemoRecorder.IsRecording())
 	{
@@ -606,6 +700,14 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick()%10) != 0)
 			continue;
 
+		// the connection can't keep up with every snapshot
+		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL &&
+			Tick()-m_aClients[i].m_LastSnapTick < m_aClients[i].m_SnapInterval*SnapPeriod)
+			continue;
+
+		m_aClients[i].m_LastSnapTick = Tick();
+		m_aClients[i].m_SnapWindowSent++;
+
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
@@ -661,6 +763,7 @@ void CServer::DoSnapshot()
 
 				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData);
 				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+				m_aClients[i].m_SnapWindowBytes += SnapshotSize;
 
 				for(int n = 0, Left = SnapshotSize; Left; n++)
 				{
@@ -961,8 +1064,17 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				m_aClients[ClientID].m_SnapRate = CClient::SNAPRATE_FULL;
 
 			if(m_aClients[ClientID].m_Snapshots.Get(m_aClients[ClientID].m_LastAckedSnapshot, &TagTime, 0, 0) >= 0)
+			{
 				m_aClients[ClientID].m_Latency = (int)(((time_get()-TagTime)*1000)/time_freq());
 
+				// the client acks the newest snapshot it got, count each one once
+				if(m_aClients[ClientID].m_LastAckedSnapshot > m_aClients[ClientID].m_LastCountedAck)
+				{
+					m_aClients[ClientID].m_LastCountedAck = m_aClients[ClientID].m_LastAckedSnapshot;
+					m_aClients[ClientID].m_SnapWindowAcked++;
+				}
+			}
+
 			// add message to report the input timing
 			// skip packets that are old
 			if(IntendedTick > m_aClients[ClientID].m_LastInputTick)
@@ -976,21 +1088,30 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			}
 
 			m_aClients[ClientID].m_LastInputTick = IntendedTick;
-
-			pInput = &m_aClients[ClientID].m_aInputs[m_aClients[ClientID].m_CurrentInput];
+			m_aClients[ClientID].m_NumInputs++;
 
 			if(IntendedTick <= Tick())
+			{
 				IntendedTick = Tick()+1;
+				m_aClients[ClientID].m_NumInputsLate++;
+			}
 
-			pInput->m_GameTick = IntendedTick;
+			pInput = &m_aClients[ClientID].m_aInputs[IntendedTick&(INPUT_RING_SIZE-1)];
+
+			// a newer input for the same tick replaces the old one,
+			// inputs too far ahead can't be stored without overwriting earlier ticks
+			if(pInput->m_GameTick == IntendedTick || IntendedTick-Tick() >= INPUT_RING_SIZE)
+				m_aClients[ClientID].m_NumInputsDropped++;
+			if(IntendedTick-Tick() >= INPUT_RING_SIZE)
+				pInput = &m_aClients[ClientID].m_LatestInput;
+			else
+				pInput->m_GameTick = IntendedTick;
 
 			for(int i = 0; i < Size/4; i++)
 				pInput->m_aData[i] = Unpacker.GetInt();
 
-			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
-
-			m_aClients[ClientID].m_CurrentInput++;
-			m_aClients[ClientID].m_CurrentInput %= 200;
+			if(pInput != &m_aClients[ClientID].m_LatestInput)
+				mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
 
 			// call the mod with the fresh input data
 			if(m_aClients[ClientID].m_State == CClient::STATE_INGAME)
@@ -1160,7 +1281,7 @@ void CServer::SendServerInfoConnless(const NETADDR *pAddr, int Token, int Type)
 	SendServerInfo(pAddr, Token, Type, SendClients);
 }
 
-void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients)
+void CServer::BuildServerInfo(CServerInfoCache *pCache, int Type, bool SendClients)
 {
 	// One chance to improve the protocol!
 	CPacker p;
@@ -1179,6 +1300,15 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 		}
 	}
 
+	// the other shards share the port, report the totals
+	int MaxClients = m_NetServer.MaxClients();
+	if(m_Shard.Active())
+	{
+		PlayerCount += m_Shard.OtherPlayers();
+		ClientCount += m_Shard.OtherClients();
+		MaxClients += m_Shard.OtherMaxClients();
+	}
+
 	p.Reset();
 
 #define ADD_RAW(p, x) (p).AddRaw(x, sizeof(x))
@@ -1198,7 +1328,8 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 	default: dbg_assert(false, "unknown serverinfo type");
 	}
 
-	ADD_INT(p, Token);
+	// the token goes here, it's added per request
+	int TokenOffset = p.Size();
 
 	p.AddString(GameServer()->Version(), 32);
 
@@ -1212,14 +1343,14 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 	}
 	else
 	{
-		if(m_NetServer.MaxClients() <= VANILLA_MAX_CLIENTS)
+		if(MaxClients <= VANILLA_MAX_CLIENTS)
 		{
 			p.AddString(aBuf, 64);
 		}
 		else
 		{
 			char aNameBuf[64];
-			str_format(aNameBuf, sizeof(aNameBuf), "%s [%d/%d]", g_Config.m_SvName, ClientCount, m_NetServer.MaxClients());
+			str_format(aNameBuf, sizeof(aNameBuf), "%s [%d/%d]", g_Config.m_SvName, ClientCount, MaxClients);
 			p.AddString(aBuf, 64);
 		}
 	}
@@ -1237,7 +1368,6 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 	// flags
 	ADD_INT(p, g_Config.m_Password[0] ? SERVER_FLAG_PASSWORD : 0);
 
-	int MaxClients = m_NetServer.MaxClients();
 	if(Type == SERVERINFO_VANILLA || Type == SERVERINFO_INGAME)
 	{
 		if(ClientCount >= VANILLA_MAX_CLIENTS)
@@ -1265,20 +1395,20 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 	int PrefixSize = p.Size();
 
 	CPacker pp;
-	CNetChunk Packet;
 	int PacketsSent = 0;
 	int PlayersSent = 0;
-	Packet.m_ClientID = -1;
-	Packet.m_Address = *pAddr;
-	Packet.m_Flags = NETSENDFLAG_CONNLESS;
+	int MoreTokenOffset = TokenOffset;
+	pCache->m_NumPackets = 0;
 
 	#define SEND(size) \
 		do \
 		{ \
-			Packet.m_pData = pp.Data(); \
-			Packet.m_DataSize = size; \
-			m_NetServer.Send(&Packet); \
-			PacketsSent++; \
+			dbg_assert(PacketsSent < CServerInfoCache::MAX_PACKETS, "too many serverinfo packets"); \
+			CServerInfoCache::CPacket *pPacket = &pCache->m_aPackets[PacketsSent]; \
+			mem_copy(pPacket->m_aData, pp.Data(), size); \
+			pPacket->m_Size = size; \
+			pPacket->m_TokenOffset = PacketsSent ? MoreTokenOffset : TokenOffset; \
+			pCache->m_NumPackets = ++PacketsSent; \
 		} while(0)
 
 	#define RESET() \
@@ -1301,6 +1431,8 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 
 	if(Type == SERVERINFO_EXTENDED)
 	{
+		// the token follows the prefix in every further packet
+		MoreTokenOffset = sizeof(SERVERBROWSE_INFO_EXTENDED_MORE);
 		pPrefix = SERVERBROWSE_INFO_EXTENDED_MORE;
 		PrefixSize = sizeof(SERVERBROWSE_INFO_EXTENDED_MORE);
 	}
@@ -1358,13 +1490,12 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 
 			if(Type == SERVERINFO_EXTENDED)
 			{
-				if(pp.Size() >= NET_MAX_PAYLOAD)
+				if(pp.Size() >= NET_MAX_PAYLOAD-MAX_TOKEN_SIZE)
 				{
 					// Retry current player.
 					i--;
 					SEND(PreviousSize);
 					RESET();
-					ADD_INT(pp, Token);
 					ADD_INT(pp, PacketsSent);
 					pp.AddString("", 0); // extra info, reserved
 					continue;
@@ -1381,8 +1512,74 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool Sen
 	#undef ADD_INT
 }
 
+void CServer::CheckServerInfo()
+{
+	// joins, leaves and team changes aren't reported to us,
+	// so look for them at most once per tick
+	if(m_ServerInfoCheckTick == m_CurrentGameTick)
+		return;
+	m_ServerInfoCheckTick = m_CurrentGameTick;
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		// the name and clan are only reported once the client is in game
+		int State = 0;
+		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
+		{
+			State = GameServer()->IsClientPlayer(i) ? 2 : 1;
+			if(m_aClients[i].m_State == CClient::STATE_INGAME)
+				State |= 4;
+		}
+		if(State != m_aServerInfoClientState[i])
+		{
+			m_aServerInfoClientState[i] = State;
+			ExpireServerInfo();
+		}
+	}
+
+	if(m_ServerInfoSpectatorSlots != g_Config.m_SvSpectatorSlots)
+	{
+		m_ServerInfoSpectatorSlots = g_Config.m_SvSpectatorSlots;
+		ExpireServerInfo();
+	}
+}
+
+void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients)
+{
+	CheckServerInfo();
+
+	CServerInfoCache *pCache = &m_aServerInfoCache[Type*2+(SendClients ? 1 : 0)];
+	if(pCache->m_Version != m_ServerInfoVersion)
+	{
+		BuildServerInfo(pCache, Type, SendClients);
+		pCache->m_Version = m_ServerInfoVersion;
+	}
+
+	char aToken[MAX_TOKEN_SIZE];
+	str_format(aToken, sizeof(aToken), "%d", Token);
+	int TokenSize = str_length(aToken)+1;
+
+	unsigned char aData[NET_MAX_PAYLOAD];
+	CNetChunk Packet;
+	Packet.m_ClientID = -1;
+	Packet.m_Address = *pAddr;
+	Packet.m_Flags = NETSENDFLAG_CONNLESS;
+	Packet.m_pData = aData;
+
+	for(int i = 0; i < pCache->m_NumPackets; i++)
+	{
+		const CServerInfoCache::CPacket *pPacket = &pCache->m_aPackets[i];
+		mem_copy(aData, pPacket->m_aData, pPacket->m_TokenOffset);
+		mem_copy(aData+pPacket->m_TokenOffset, aToken, TokenSize);
+		mem_copy(aData+pPacket->m_TokenOffset+TokenSize, pPacket->m_aData+pPacket->m_TokenOffset, pPacket->m_Size-pPacket->m_TokenOffset);
+		Packet.m_DataSize = pPacket->m_Size+TokenSize;
+		m_NetServer.Send(&Packet);
+	}
+}
+
 void CServer::UpdateServerInfo()
 {
+	ExpireServerInfo();
 	for(int i = 0; i < MAX_CLIENTS; ++i)
 	{
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
@@ -1393,6 +1590,35 @@ void CServer::UpdateServerInfo()
 }
 
 
+void CServer::UpdateShard()
+{
+	if(!m_Shard.Active())
+		return;
+
+	// master server packets the other shards received
+	CNetChunk Packet;
+	while(m_Shard.Recv(&Packet))
+		m_Register.RegisterProcessPacket(&Packet);
+
+	if(m_Shard.StatusDue())
+	{
+		int PlayerCount = 0, ClientCount = 0;
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(m_aClients[i].m_State != CClient::STATE_EMPTY)
+			{
+				if(GameServer()->IsClientPlayer(i))
+					PlayerCount++;
+				ClientCount++;
+			}
+		}
+		m_Shard.SendStatus(PlayerCount, ClientCount, m_NetServer.MaxClients());
+	}
+
+	if(m_Shard.Update())
+		ExpireServerInfo();
+}
+
 void CServer::PumpNetwork()
 {
 	CNetChunk Packet;
@@ -1405,7 +1631,9 @@ void CServer::PumpNetwork()
 		if(Packet.m_ClientID == -1)
 		{
 			// stateless
-			if(!m_Register.RegisterProcessPacket(&Packet))
+			if(m_Shard.Active() && !m_Shard.IsCoordinator() && CRegister::IsRegisterPacket(&Packet))
+				m_Shard.Forward(&Packet);
+			else if(!m_Register.RegisterProcessPacket(&Packet))
 			{
 				int ExtraToken = 0;
 				int Type = -1;
@@ -1451,6 +1679,29 @@ void CServer::SetCustClt(int ClientID)
 	m_aClients[ClientID].m_CustClt = 1;
 }
 
+CPlayerData *CServer::GetPlayerData(int ClientID, int ColorID)
+{
+	// records are keyed by name, which is only final once the client is in game
+	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State != CClient::STATE_INGAME)
+		return 0;
+	return m_pPlayerData->Get(ClientName(ClientID), ColorID);
+}
+
+bool CServer::SavePlayerData(CPlayerData *pData)
+{
+	return m_pPlayerData->Save(pData);
+}
+
+int CServer::GetHighScore()
+{
+	return m_pPlayerData->GetHighScore();
+}
+
+int CServer::GetPlayerCount()
+{
+	return m_pPlayerData->GetPlayerCount();
+}
+
 char *CServer::GetMapName()
 {
 	// get the name of the map without his path
@@ -1463,6 +1714,62 @@ char *CServer::GetMapName()
 	return pMapShortName;
 }
 
+void CServer::SetGeneratedMap(const char *pMapName, unsigned char *pData, unsigned Size, bool SaveToDisk)
+{
+	if(m_pPendingMapData)
+		mem_free(m_pPendingMapData);
+	str_copy(m_aPendingMap, pMapName, sizeof(m_aPendingMap));
+	m_pPendingMapData = pData;
+	m_PendingMapSize = Size;
+
+	if(!SaveToDisk)
+		return;
+
+	if(m_MapSave.m_Job.Status() != CJob::STATE_DONE)
+	{
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "previous generated map is still being saved, skipping disk copy");
+		return;
+	}
+
+	// write a copy in the background, the game doesn't need to wait for it
+	m_MapSave.m_pStorage = Storage();
+	str_format(m_MapSave.m_aFilename, sizeof(m_MapSave.m_aFilename), "maps/%s.map", pMapName);
+	m_MapSave.m_pData = (unsigned char *)mem_alloc(Size, 1);
+	mem_copy(m_MapSave.m_pData, pData, Size);
+	m_MapSave.m_Size = Size;
+	Kernel()->RequestInterface<IEngine>()->AddJob(&m_MapSave.m_Job, SaveMapThread, &m_MapSave);
+}
+
+int CServer::SaveMapThread(void *pUser)
+{
+	CMapSave *pSave = (CMapSave *)pUser;
+
+	// Map will be saved to current dir, not to ~/.ninslash/maps or to data/maps, so we need to create a dir for it
+	pSave->m_pStorage->CreateFolder("maps", IStorage::TYPE_SAVE);
+
+	// write to a temporary file first, the current map may still be mapped into memory
+	char aTmpFile[256];
+	str_format(aTmpFile, sizeof(aTmpFile), "%s.tmp", pSave->m_aFilename);
+	IOHANDLE File = pSave->m_pStorage->OpenFile(aTmpFile, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	int Result = -1;
+	if(File)
+	{
+		unsigned Written = io_write(File, pSave->m_pData, pSave->m_Size);
+		io_close(File);
+		if(Written == pSave->m_Size)
+		{
+			pSave->m_pStorage->RemoveFile(pSave->m_aFilename, IStorage::TYPE_SAVE);
+			if(pSave->m_pStorage->RenameFile(aTmpFile, pSave->m_aFilename, IStorage::TYPE_SAVE))
+				Result = 0;
+		}
+	}
+	dbg_msg("server", "saving generated map '%s' %s", pSave->m_aFilename, Result == 0 ? "done" : "failed");
+
+	mem_free(pSave->m_pData);
+	pSave->m_pData = 0;
+	return Result;
+}
+
 int CServer::LoadMap(const char *pMapName)
 {
 	//DATAFILE *df;
@@ -1473,15 +1780,36 @@ int CServer::LoadMap(const char *pMapName)
 	if(!df)
 		return 0;*/
 
-	// check for valid standard map
-	if(!m_MapChecker.ReadAndValidateMap(Storage(), aBuf, IStorage::TYPE_ALL))
+	if(m_pPendingMapData && str_comp(m_aPendingMap, pMapName) == 0)
 	{
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
-		return 0;
+		// generated map handed over in memory, no need to touch the disk
+		unsigned char *pData = m_pPendingMapData;
+		m_pPendingMapData = 0;
+		if(!m_pMap->LoadFromMemory(pData, m_PendingMapSize))
+			return 0;
+		m_CurrentMapInMemory = true;
 	}
+	else if(m_CurrentMapInMemory && m_pCurrentMapData && str_comp(m_aCurrentMap, pMapName) == 0)
+	{
+		// reload of an in-memory map, start over from a copy of its image
+		unsigned char *pData = (unsigned char *)mem_alloc(m_CurrentMapSize, 1);
+		mem_copy(pData, m_pCurrentMapData, m_CurrentMapSize);
+		if(!m_pMap->LoadFromMemory(pData, m_CurrentMapSize))
+			return 0;
+	}
+	else
+	{
+		// check for valid standard map
+		if(!m_MapChecker.ReadAndValidateMap(Storage(), aBuf, IStorage::TYPE_ALL))
+		{
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
+			return 0;
+		}
 
-	if(!m_pMap->Load(aBuf))
-		return 0;
+		if(!m_pMap->Load(aBuf))
+			return 0;
+		m_CurrentMapInMemory = false;
+	}
 
 	// stop recording when we change map
 	m_DemoRecorder.Stop();
@@ -1498,16 +1826,9 @@ int CServer::LoadMap(const char *pMapName)
 	str_copy(m_aCurrentMap, pMapName, sizeof(m_aCurrentMap));
 	//map_set(df);
 
-	// load complete map into memory for download
-	{
-		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
-		m_CurrentMapSize = (int)io_length(File);
-		if(m_pCurrentMapData)
-			mem_free(m_pCurrentMapData);
-		m_pCurrentMapData = (unsigned char *)mem_alloc(m_CurrentMapSize, 1);
-		io_read(File, m_pCurrentMapData, m_CurrentMapSize);
-		io_close(File);
-	}
+	// serve downloads straight from the loaded map image
+	m_pCurrentMapData = m_pMap->FileData();
+	m_CurrentMapSize = (int)m_pMap->FileSize();
 	return 1;
 }
 
@@ -1543,20 +1864,32 @@ int CServer::Run()
 		BindAddr.port = g_Config.m_SvPort;
 	}
 
-	if(!m_NetServer.Open(BindAddr, &m_ServerBan, g_Config.m_SvMaxClients, g_Config.m_SvMaxClientsPerIP, 0))
+	if(!m_NetServer.Open(BindAddr, &m_ServerBan, g_Config.m_SvMaxClients, g_Config.m_SvMaxClientsPerIP, g_Config.m_SvShard ? NETCREATE_FLAG_REUSEPORT : 0))
 	{
 		dbg_msg("server", "couldn't open socket. port %d might already be in use", g_Config.m_SvPort);
 		return -1;
 	}
 
+	if(g_Config.m_SvShard && !m_Shard.Init(g_Config.m_SvShardID, g_Config.m_SvShardPort))
+		return -1;
+
 	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, DelClientCallback, this);
 
+	if(g_Config.m_SvNetThread && m_NetIOThread.Start(m_NetServer.Socket()))
+	{
+		m_NetServer.SetIOThread(&m_NetIOThread);
+		CNetBase::SetIOThread(&m_NetIOThread);
+	}
+
 	m_Econ.Init(Console(), &m_ServerBan);
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "server name is '%s'", g_Config.m_SvName);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 
+	m_pPlayerData = new CPlayerDataStore;
+	m_pPlayerData->Init(Storage(), "playerdata");
+
 	GameServer()->OnInit();
 	str_format(aBuf, sizeof(aBuf), "version %s", GameServer()->NetVersion());
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
@@ -1628,15 +1961,9 @@ int CServer::Run()
 				{
 					if(m_aClients[c].m_State == CClient::STATE_EMPTY)
 						continue;
-					for(int i = 0; i < 200; i++)
-					{
-						if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
-						{
-							if(m_aClients[c].m_State == CClient::STATE_INGAME)
-								GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
-							break;
-						}
-					}
+					CClient::CInput *pInput = &m_aClients[c].m_aInputs[Tick()&(INPUT_RING_SIZE-1)];
+					if(pInput->m_GameTick == Tick() && m_aClients[c].m_State == CClient::STATE_INGAME)
+						GameServer()->OnClientPredictedInput(c, pInput->m_aData);
 				}
 
 				GameServer()->OnTick();
@@ -1651,8 +1978,10 @@ int CServer::Run()
 				UpdateClientRconCommands();
 			}
 
-			// master server stuff
-			m_Register.RegisterUpdate(m_NetServer.NetType());
+			// master server stuff, only the coordinating shard registers
+			if(!m_Shard.Active() || m_Shard.IsCoordinator())
+				m_Register.RegisterUpdate(m_NetServer.NetType());
+			UpdateShard();
 
 			PumpNetwork();
 
@@ -1682,7 +2011,10 @@ int CServer::Run()
 			}
 
 			// wait for incomming data
-			net_socket_read_wait(m_NetServer.Socket(), 5);
+			if(m_NetIOThread.Running())
+				m_NetIOThread.WaitRecv(5);
+			else
+				net_socket_read_wait(m_NetServer.Socket(), 5);
 		}
 	}
 	// disconnect all clients on shutdown
@@ -1694,11 +2026,23 @@ int CServer::Run()
 		m_Econ.Shutdown();
 	}
 
+	m_Shard.Shutdown();
+
+	// flush the shutdown messages before the network thread goes away
+	CNetBase::SetIOThread(0);
+	m_NetServer.SetIOThread(0);
+	m_NetIOThread.Stop();
+
 	GameServer()->OnShutdown();
+	m_pPlayerData->Shutdown();
+	delete m_pPlayerData;
+	m_pPlayerData = 0;
 	m_pMap->Unload();
+	m_pCurrentMapData = 0;
 
-	if(m_pCurrentMapData)
-		mem_free(m_pCurrentMapData);
+	if(m_pPendingMapData)
+		mem_free(m_pPendingMapData);
+	m_pPendingMapData = 0;
 	return 0;
 }
 
@@ -1729,8 +2073,10 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 			{
 				const char *pAuthStr = pThis->m_aClients[i].m_Authed == CServer::AUTHED_ADMIN ? "(Admin)" :
 										pThis->m_aClients[i].m_Authed == CServer::AUTHED_MOD ? "(Mod)" : "";
-				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s name='%s' score=%d secure=%s %s", i, aAddrStr,
-					pThis->m_aClients[i].m_aName, pThis->m_aClients[i].m_Score, pThis->m_NetServer.HasSecurityToken(i) ? "yes":"no", pAuthStr);
+				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s name='%s' score=%d secure=%s inputs=%d late=%d dropped=%d snapinterval=%d snaploss=%d%% %s", i, aAddrStr,
+					pThis->m_aClients[i].m_aName, pThis->m_aClients[i].m_Score, pThis->m_NetServer.HasSecurityToken(i) ? "yes":"no",
+					pThis->m_aClients[i].m_NumInputs, pThis->m_aClients[i].m_NumInputsLate, pThis->m_aClients[i].m_NumInputsDropped,
+					pThis->m_aClients[i].m_SnapInterval, pThis->m_aClients[i].m_SnapLoss, pAuthStr);
 			}
 			else
 				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s connecting", i, aAddrStr);
@@ -1753,7 +2099,7 @@ void CServer::DemoRecorder_HandleAutoStart()
 		char aDate[20];
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/%s_%s.demo", "auto/autorecord", aDate);
-		m_DemoRecorder.Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapCrc, "server");
+		m_DemoRecorder.Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapCrc, "server", m_pCurrentMapData, m_CurrentMapSize);
 		if(g_Config.m_SvAutoDemoMax)
 		{
 			// clean up auto recorded demos
@@ -1781,7 +2127,7 @@ void CServer::ConRecord(IConsole::IResult *pResult, void *pUser)
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/demo_%s.demo", aDate);
 	}
-	pServer->m_DemoRecorder.Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_aCurrentMap, pServer->m_CurrentMapCrc, "server");
+	pServer->m_DemoRecorder.Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_aCurrentMap, pServer->m_CurrentMapCrc, "server", pServer->m_pCurrentMapData, pServer->m_CurrentMapSize);
 }
 
 void CServer::ConStopRecord(IConsole::IResult *pResult, void *pUser)
@@ -2012,6 +2358,7 @@ int main(int argc, const char **argv) // ignore_convention
 	pConfig->RestoreStrings();
 
 	pEngine->InitLogfile();
+	pEngine->InitJobs();
 
 	// run the server
 	dbg_msg("server", "starting...");
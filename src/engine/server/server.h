@@ -59,19 +59,31 @@ public:
 };
 
 
+class CMapSave
+{
+public:
+	CJob m_Job;
+	class IStorage *m_pStorage;
+	char m_aFilename[128];
+	unsigned char *m_pData;
+	unsigned m_Size;
+};
+
+
 class CServer : public IServer
 {
 	class IGameServer *m_pGameServer;
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
 
-	class CPlayerData *m_pPlayerData;
+	class CPlayerDataStore *m_pPlayerData;
 public:
 	class IGameServer *GameServer() { return m_pGameServer; }
 	class IConsole *Console() { return m_pConsole; }
 	class IStorage *Storage() { return m_pStorage; }
 
 	class CPlayerData *GetPlayerData(int ClientID, int ColorID);
+	bool SavePlayerData(class CPlayerData *pData);
 	int GetHighScore();
 	int GetPlayerCount();
 
@@ -82,6 +94,15 @@ public:
 		AUTHED_ADMIN,
 
 		MAX_RCONCMD_SEND=16,
+
+		// must be a power of two, inputs further ahead than this are dropped
+		INPUT_RING_SIZE=128,
+
+		// "%d" of any int plus terminator
+		MAX_TOKEN_SIZE=12,
+
+		// snapshots the loss is measured over, slow clients take several rate decisions to fill it
+		SNAP_LOSS_SAMPLES=5,
 	};
 
 	class CClient
@@ -119,10 +140,24 @@ public:
 		int m_LastInputTick;
 		CSnapshotStorage m_Snapshots;
 
+		// adaptive snapshot rate, the interval counts snapshot periods.
+		// the window collects SNAP_LOSS_SAMPLES snapshots before the loss is updated
+		int m_SnapInterval;
+		int m_LastSnapTick;
+		int m_SnapWindowSent;
+		int m_SnapWindowAcked;
+		int m_SnapWindowBytes;
+		int m_LastCountedAck;
+		int m_LastResends;
+		int m_SnapLoss; // percent, smoothed
+
 
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
-		int m_CurrentInput;
+		// slot is the game tick modulo INPUT_RING_SIZE
+		CInput m_aInputs[INPUT_RING_SIZE];
+		int m_NumInputs;
+		int m_NumInputsLate;
+		int m_NumInputsDropped;
 
 		char m_aName[MAX_NAME_LENGTH];
 		char m_aClan[MAX_CLAN_LENGTH];
@@ -147,6 +182,7 @@ public:
 	CSnapshotBuilder m_SnapshotBuilder;
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
+	CNetIOThread m_NetIOThread;
 	CEcon m_Econ;
 	CServerBan m_ServerBan;
 
@@ -165,21 +201,58 @@ public:
 
 	char m_aCurrentMap[64];
 	unsigned m_CurrentMapCrc;
-	unsigned char *m_pCurrentMapData;
+	const unsigned char *m_pCurrentMapData; // owned by the map
 	int m_CurrentMapSize;
+	bool m_CurrentMapInMemory;
+
+	// generated map waiting to be loaded
+	char m_aPendingMap[64];
+	unsigned char *m_pPendingMapData;
+	unsigned m_PendingMapSize;
+	CMapSave m_MapSave;
 
 	bool m_ServerInfoHighLoad;
 	int64 m_ServerInfoFirstRequest;
 	int m_ServerInfoNumRequests;
 
+	// prebuilt info packets per type, with and without the client list.
+	// the request token is spliced in at m_TokenOffset when sending
+	class CServerInfoCache
+	{
+	public:
+		enum
+		{
+			MAX_PACKETS=8,
+		};
+
+		struct CPacket
+		{
+			unsigned char m_aData[NET_MAX_PAYLOAD];
+			int m_Size;
+			int m_TokenOffset;
+		};
+
+		CPacket m_aPackets[MAX_PACKETS];
+		int m_NumPackets;
+		int m_Version;
+	};
+	CServerInfoCache m_aServerInfoCache[(SERVERINFO_INGAME+1)*2];
+	int m_ServerInfoVersion;
+	int m_ServerInfoCheckTick;
+	int m_aServerInfoClientState[MAX_CLIENTS];
+	int m_ServerInfoSpectatorSlots;
+
 	CDemoRecorder m_DemoRecorder;
 	CRegister m_Register;
+	CServerShard m_Shard;
 	CMapChecker m_MapChecker;
 
 	CServer();
 
 	int TrySetClientName(int ClientID, const char *pName);
 
+	void UpdateShard();
+
 	virtual void SetClientName(int ClientID, const char *pName);
 	virtual void SetClientClan(int ClientID, char const *pClan);
 	virtual void SetClientCountry(int ClientID, int Country);
@@ -209,6 +282,7 @@ public:
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
 	int SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System);
 
+	void UpdateSnapRates();
 	void DoSnapshot();
 	
 	static int ClientRejoinCallback(int ClientID, void *pUser);
@@ -229,11 +303,16 @@ public:
 
 	void SendServerInfoConnless(const NETADDR *pAddr, int Token, int Type);
 	void SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients);
+	void BuildServerInfo(CServerInfoCache *pCache, int Type, bool SendClients);
+	void CheckServerInfo();
+	void ExpireServerInfo() { m_ServerInfoVersion++; }
 	void UpdateServerInfo();
 
 	void PumpNetwork();
 
 	virtual char *GetMapName(); // MapGen
+	virtual void SetGeneratedMap(const char *pMapName, unsigned char *pData, unsigned Size, bool SaveToDisk);
+	static int SaveMapThread(void *pUser);
 	int LoadMap(const char *pMapName);
 
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole);
@@ -0,0 +1,251 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+#include <engine/shared/packer.h>
+
+#include "shard.h"
+
+static const unsigned char SHARD_HEADER[] = {0xff, 0xff, 0xff, 0xff, 's', 'h', 'r', 'd'};
+
+CServerShard::CServerShard()
+{
+	mem_zero(&m_Socket, sizeof(m_Socket));
+	m_ShardID = 0;
+	mem_zero(&m_CoordinatorAddr, sizeof(m_CoordinatorAddr));
+	mem_zero(m_aShards, sizeof(m_aShards));
+	m_LastStatus = 0;
+	m_LastTotals = 0;
+	m_OtherPlayers = 0;
+	m_OtherClients = 0;
+	m_OtherMaxClients = 0;
+	m_Changed = false;
+}
+
+bool CServerShard::Init(int ShardID, int Port)
+{
+	if(ShardID < 0 || ShardID >= MAX_SHARDS)
+		return false;
+
+	m_ShardID = ShardID;
+	net_addr_from_str(&m_CoordinatorAddr, "127.0.0.1");
+	m_CoordinatorAddr.port = Port;
+
+	// only local processes can reach the loopback address
+	NETADDR BindAddr = m_CoordinatorAddr;
+	if(IsCoordinator())
+		m_Socket = net_udp_create(BindAddr, 0);
+	else
+	{
+		BindAddr.port = 0;
+		m_Socket = net_udp_create(BindAddr, 1);
+	}
+
+	if(!m_Socket.type)
+	{
+		dbg_msg("shard", "couldn't open the shard socket. port %d might already be in use", Port);
+		return false;
+	}
+
+	mem_zero(m_aShards, sizeof(m_aShards));
+	m_LastStatus = 0;
+	m_LastTotals = time_get();
+	m_OtherPlayers = m_OtherClients = m_OtherMaxClients = 0;
+	m_Changed = false;
+
+	dbg_msg("shard", "shard %d started%s", m_ShardID, IsCoordinator() ? ", coordinating" : "");
+	return true;
+}
+
+void CServerShard::Shutdown()
+{
+	if(!Active())
+		return;
+	net_udp_close(m_Socket);
+	mem_zero(&m_Socket, sizeof(m_Socket));
+}
+
+void CServerShard::SendMsg(const NETADDR *pAddr, const CPacker *pPacker)
+{
+	unsigned char aBuffer[NET_MAX_PACKETSIZE];
+	if(sizeof(SHARD_HEADER) + pPacker->Size() > sizeof(aBuffer))
+		return;
+	mem_copy(aBuffer, SHARD_HEADER, sizeof(SHARD_HEADER));
+	mem_copy(aBuffer + sizeof(SHARD_HEADER), pPacker->Data(), pPacker->Size());
+	net_udp_send(m_Socket, pAddr, aBuffer, sizeof(SHARD_HEADER) + pPacker->Size());
+}
+
+void CServerShard::SetOthers(int NumPlayers, int NumClients, int MaxClients)
+{
+	if(NumPlayers == m_OtherPlayers && NumClients == m_OtherClients && MaxClients == m_OtherMaxClients)
+		return;
+	m_OtherPlayers = NumPlayers;
+	m_OtherClients = NumClients;
+	m_OtherMaxClients = MaxClients;
+	m_Changed = true;
+}
+
+void CServerShard::SendTotals()
+{
+	int64 Now = time_get();
+	int NumPlayers = 0, NumClients = 0, MaxClients = 0;
+	for(int i = 0; i < MAX_SHARDS; i++)
+	{
+		CShardInfo *pShard = &m_aShards[i];
+		if(pShard->m_LastSeen && pShard->m_LastSeen+time_freq()*TIMEOUT < Now)
+		{
+			dbg_msg("shard", "shard %d timed out", i);
+			pShard->m_LastSeen = 0;
+		}
+		if(!pShard->m_LastSeen)
+			continue;
+		NumPlayers += pShard->m_NumPlayers;
+		NumClients += pShard->m_NumClients;
+		MaxClients += pShard->m_MaxClients;
+	}
+
+	// everyone gets the totals minus its own counts
+	for(int i = 1; i < MAX_SHARDS; i++)
+	{
+		CShardInfo *pShard = &m_aShards[i];
+		if(!pShard->m_LastSeen)
+			continue;
+
+		CPacker Packer;
+		Packer.Reset();
+		Packer.AddInt(MSG_TOTALS);
+		Packer.AddInt(NumPlayers - pShard->m_NumPlayers);
+		Packer.AddInt(NumClients - pShard->m_NumClients);
+		Packer.AddInt(MaxClients - pShard->m_MaxClients);
+		SendMsg(&pShard->m_Addr, &Packer);
+	}
+
+	SetOthers(NumPlayers - m_aShards[0].m_NumPlayers, NumClients - m_aShards[0].m_NumClients, MaxClients - m_aShards[0].m_MaxClients);
+}
+
+bool CServerShard::Recv(CNetChunk *pChunk)
+{
+	if(!Active())
+		return false;
+
+	while(1)
+	{
+		NETADDR Addr;
+		int Bytes = net_udp_recv(m_Socket, &Addr, m_aRecvBuffer, sizeof(m_aRecvBuffer));
+		if(Bytes <= 0)
+			return false;
+
+		if(Bytes < (int)sizeof(SHARD_HEADER) || mem_comp(m_aRecvBuffer, SHARD_HEADER, sizeof(SHARD_HEADER)) != 0)
+			continue;
+
+		CUnpacker Unpacker;
+		Unpacker.Reset(m_aRecvBuffer + sizeof(SHARD_HEADER), Bytes - sizeof(SHARD_HEADER));
+		int Msg = Unpacker.GetInt();
+
+		if(Msg == MSG_STATUS && IsCoordinator())
+		{
+			int ShardID = Unpacker.GetInt();
+			int NumPlayers = Unpacker.GetInt();
+			int NumClients = Unpacker.GetInt();
+			int MaxClients = Unpacker.GetInt();
+			if(Unpacker.Error() || ShardID <= 0 || ShardID >= MAX_SHARDS)
+				continue;
+
+			CShardInfo *pShard = &m_aShards[ShardID];
+			if(!pShard->m_LastSeen)
+				dbg_msg("shard", "shard %d joined", ShardID);
+			pShard->m_Addr = Addr;
+			pShard->m_LastSeen = time_get();
+			pShard->m_NumPlayers = NumPlayers;
+			pShard->m_NumClients = NumClients;
+			pShard->m_MaxClients = MaxClients;
+		}
+		else if(Msg == MSG_TOTALS && !IsCoordinator())
+		{
+			int NumPlayers = Unpacker.GetInt();
+			int NumClients = Unpacker.GetInt();
+			int MaxClients = Unpacker.GetInt();
+			if(Unpacker.Error())
+				continue;
+
+			m_LastTotals = time_get();
+			SetOthers(NumPlayers, NumClients, MaxClients);
+		}
+		else if(Msg == MSG_FORWARD && IsCoordinator())
+		{
+			const NETADDR *pAddr = (const NETADDR *)Unpacker.GetRaw(sizeof(NETADDR));
+			int Size = Unpacker.GetInt();
+			const unsigned char *pData = Size > 0 ? Unpacker.GetRaw(Size) : 0;
+			if(Unpacker.Error() || !pData)
+				continue;
+
+			mem_zero(pChunk, sizeof(*pChunk));
+			pChunk->m_ClientID = -1;
+			pChunk->m_Flags = NETSENDFLAG_CONNLESS;
+			mem_copy(&pChunk->m_Address, pAddr, sizeof(NETADDR));
+			pChunk->m_DataSize = Size;
+			pChunk->m_pData = pData;
+			return true;
+		}
+	}
+}
+
+bool CServerShard::Update()
+{
+	if(!Active())
+		return false;
+
+	// lost the coordinator, only count ourselves
+	if(!IsCoordinator() && m_LastTotals+time_freq()*TIMEOUT < time_get())
+	{
+		m_LastTotals = time_get();
+		SetOthers(0, 0, 0);
+	}
+
+	bool Changed = m_Changed;
+	m_Changed = false;
+	return Changed;
+}
+
+bool CServerShard::StatusDue() const
+{
+	return Active() && m_LastStatus+time_freq()*STATUS_INTERVAL < time_get();
+}
+
+void CServerShard::SendStatus(int NumPlayers, int NumClients, int MaxClients)
+{
+	m_LastStatus = time_get();
+
+	if(IsCoordinator())
+	{
+		m_aShards[0].m_LastSeen = m_LastStatus;
+		m_aShards[0].m_NumPlayers = NumPlayers;
+		m_aShards[0].m_NumClients = NumClients;
+		m_aShards[0].m_MaxClients = MaxClients;
+		SendTotals();
+		return;
+	}
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(MSG_STATUS);
+	Packer.AddInt(m_ShardID);
+	Packer.AddInt(NumPlayers);
+	Packer.AddInt(NumClients);
+	Packer.AddInt(MaxClients);
+	SendMsg(&m_CoordinatorAddr, &Packer);
+}
+
+void CServerShard::Forward(const CNetChunk *pChunk)
+{
+	if(!Active() || IsCoordinator())
+		return;
+
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddInt(MSG_FORWARD);
+	Packer.AddRaw(&pChunk->m_Address, sizeof(NETADDR));
+	Packer.AddInt(pChunk->m_DataSize);
+	Packer.AddRaw(pChunk->m_pData, pChunk->m_DataSize);
+	if(!Packer.Error())
+		SendMsg(&m_CoordinatorAddr, &Packer);
+}
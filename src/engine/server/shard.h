@@ -0,0 +1,92 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SERVER_SHARD_H
+#define ENGINE_SERVER_SHARD_H
+
+#include <engine/shared/network.h>
+
+/*
+	Several server processes can share one port (SO_REUSEPORT), each with
+	its own world. Shard 0 coordinates: it is the only one registering at
+	the master servers, the other shards forward the master handshake to
+	it and everyone reports their player counts so the server info shows
+	the totals. The shards talk over a loopback udp socket.
+*/
+class CServerShard
+{
+public:
+	enum
+	{
+		MAX_SHARDS=16,
+	};
+
+private:
+	enum
+	{
+		MSG_STATUS=1,
+		MSG_TOTALS,
+		MSG_FORWARD,
+
+		STATUS_INTERVAL=1,
+		TIMEOUT=5,
+	};
+
+	struct CShardInfo
+	{
+		NETADDR m_Addr;
+		int64 m_LastSeen;
+		int m_NumPlayers;
+		int m_NumClients;
+		int m_MaxClients;
+	};
+
+	NETSOCKET m_Socket;
+	int m_ShardID;
+	NETADDR m_CoordinatorAddr;
+
+	// coordinator only
+	CShardInfo m_aShards[MAX_SHARDS];
+
+	int64 m_LastStatus;
+	int64 m_LastTotals;
+
+	// counts of all the other shards
+	int m_OtherPlayers;
+	int m_OtherClients;
+	int m_OtherMaxClients;
+
+	bool m_Changed;
+
+	// forwarded chunks point into this
+	unsigned char m_aRecvBuffer[NET_MAX_PACKETSIZE];
+
+	void SendMsg(const NETADDR *pAddr, const class CPacker *pPacker);
+	void SetOthers(int NumPlayers, int NumClients, int MaxClients);
+	void SendTotals();
+
+public:
+	CServerShard();
+
+	bool Init(int ShardID, int Port);
+	void Shutdown();
+
+	bool Active() const { return m_Socket.type != 0; }
+	bool IsCoordinator() const { return m_ShardID == 0; }
+	int ShardID() const { return m_ShardID; }
+
+	// handles the shard messages, returns true and fills pChunk for each
+	// master server packet forwarded to the coordinator
+	bool Recv(struct CNetChunk *pChunk);
+	// returns true once after the counts of the other shards changed
+	bool Update();
+
+	bool StatusDue() const;
+	void SendStatus(int NumPlayers, int NumClients, int MaxClients);
+	void Forward(const struct CNetChunk *pChunk);
+
+	int OtherPlayers() const { return m_OtherPlayers; }
+	int OtherClients() const { return m_OtherClients; }
+	int OtherMaxClients() const { return m_OtherMaxClients; }
+};
+
+#endif
@@ -14,6 +14,7 @@ MACRO_CONFIG_INT(PlayerCountry, player_country, -1, -1, 1000, CFGFLAG_SAVE|CFGFL
 MACRO_CONFIG_STR(Password, password, 32, "", CFGFLAG_CLIENT|CFGFLAG_SERVER, "Password to the server")
 MACRO_CONFIG_STR(Logfile, logfile, 128, "", CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Filename to log all output to")
 MACRO_CONFIG_INT(ConsoleOutputLevel, console_output_level, 0, 0, 2, CFGFLAG_SERVER, "Adjusts the amount of information in the console")
+MACRO_CONFIG_INT(JobThreads, job_threads, 2, 1, 16, CFGFLAG_CLIENT|CFGFLAG_SERVER, "Number of worker threads for background and per-tick jobs")
 
 MACRO_CONFIG_INT(ClCpuThrottle, cl_cpu_throttle, 0, 0, 100, CFGFLAG_SAVE|CFGFLAG_CLIENT, "")
 MACRO_CONFIG_INT(ClEditor, cl_editor, 0, 0, 1, CFGFLAG_CLIENT, "")
@@ -86,6 +87,12 @@ MACRO_CONFIG_STR(SvMap, sv_map, 128, "dm1", CFGFLAG_SERVER, "Map to use on the s
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, 32, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
+MACRO_CONFIG_INT(SvSnapAdaptive, sv_snap_adaptive, 1, 0, 1, CFGFLAG_SERVER, "Lower the snapshot rate of clients with lossy or slow connections")
+MACRO_CONFIG_INT(SvSnapIntervalMax, sv_snap_interval_max, 4, 1, 10, CFGFLAG_SERVER, "Longest snapshot interval for adaptive clients, in snapshot periods")
+MACRO_CONFIG_INT(SvNetThread, sv_net_thread, 0, 0, 1, CFGFLAG_SERVER, "Receive and send packets on a dedicated network thread")
+MACRO_CONFIG_INT(SvShard, sv_shard, 0, 0, 1, CFGFLAG_SERVER, "Share the port with other server processes, each running its own world")
+MACRO_CONFIG_INT(SvShardID, sv_shard_id, 0, 0, 15, CFGFLAG_SERVER, "Id of this shard, shard 0 registers at the masters and coordinates the others")
+MACRO_CONFIG_INT(SvShardPort, sv_shard_port, 8399, 1, 65535, CFGFLAG_SERVER, "Loopback port the shard coordinator listens on")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SERVER, "Remote console password (full access)")
 MACRO_CONFIG_STR(SvRconModPassword, sv_rcon_mod_password, 32, "", CFGFLAG_SERVER, "Remote console password for moderators (limited access)")
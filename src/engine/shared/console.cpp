@@ -375,9 +375,80 @@ void CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPoss
 	}
 }
 
-CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
+void CConsole::UpdateCommandsByChar()
 {
+	if(!m_CommandsByCharDirty)
+		return;
+
+	mem_zero(m_apCommandsByChar, sizeof(m_apCommandsByChar));
 	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	{
+		unsigned char c = pCommand->m_pName[0];
+		if(!m_apCommandsByChar[c])
+			m_apCommandsByChar[c] = pCommand;
+	}
+	m_CommandsByCharDirty = false;
+}
+
+void CConsole::PossibleCommandsPrefix(const char *pPrefix, int FlagMask, bool Temp, FPossibleCallback pfnCallback, void *pUser)
+{
+	if(!pPrefix[0])
+	{
+		PossibleCommands(pPrefix, FlagMask, Temp, pfnCallback, pUser);
+		return;
+	}
+
+	UpdateCommandsByChar();
+
+	// the list is sorted, so only the runs starting with the first character in either case need to be checked
+	int Length = str_length(pPrefix);
+	unsigned char First = pPrefix[0];
+	unsigned char aStart[2] = { (unsigned char)(First >= 'A' && First <= 'Z' ? First+32 : First), (unsigned char)(First >= 'a' && First <= 'z' ? First-32 : First) };
+	for(int i = 0; i < 2 && (i == 0 || aStart[1] != aStart[0]); i++)
+	{
+		for(CCommand *pCommand = m_apCommandsByChar[aStart[i]]; pCommand && (unsigned char)pCommand->m_pName[0] == aStart[i]; pCommand = pCommand->m_pNext)
+		{
+			if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp && str_comp_nocase_num(pCommand->m_pName, pPrefix, Length) == 0)
+				pfnCallback(pCommand->m_pName, pUser);
+		}
+	}
+}
+
+unsigned CConsole::CommandHash(const char *pName)
+{
+	unsigned Hash = 2166136261u;
+	for(; *pName; pName++)
+	{
+		unsigned char c = *pName;
+		if(c >= 'A' && c <= 'Z')
+			c += 'a'-'A';
+		Hash = (Hash^c)*16777619u;
+	}
+	return Hash&(COMMAND_HASH_SIZE-1);
+}
+
+void CConsole::AddCommandHash(CCommand *pCommand)
+{
+	unsigned Hash = CommandHash(pCommand->m_pName);
+	pCommand->m_pNextHash = m_apCommandHash[Hash];
+	m_apCommandHash[Hash] = pCommand;
+}
+
+void CConsole::RemoveCommandHash(CCommand *pCommand)
+{
+	for(CCommand **ppLink = &m_apCommandHash[CommandHash(pCommand->m_pName)]; *ppLink; ppLink = &(*ppLink)->m_pNextHash)
+	{
+		if(*ppLink == pCommand)
+		{
+			*ppLink = pCommand->m_pNextHash;
+			return;
+		}
+	}
+}
+
+CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
+{
+	for(CCommand *pCommand = m_apCommandHash[CommandHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask)
 		{
@@ -686,6 +757,8 @@ CConsole::CConsole(int FlagMask)
 	m_paStrokeStr[1] = "1";
 	m_ExecutionQueue.Reset();
 	m_pFirstCommand = 0;
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
+	m_CommandsByCharDirty = true;
 	m_pFirstExec = 0;
 	mem_zero(m_aPrintCB, sizeof(m_aPrintCB));
 	m_NumPrintCB = 0;
@@ -747,12 +820,12 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
+	m_CommandsByCharDirty = true;
+	AddCommandHash(pCommand);
+
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
-		if(m_pFirstCommand && m_pFirstCommand->m_pNext)
-			pCommand->m_pNext = m_pFirstCommand;
-		else
-			pCommand->m_pNext = 0;
+		pCommand->m_pNext = m_pFirstCommand;
 		m_pFirstCommand = pCommand;
 	}
 	else
@@ -857,6 +930,8 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandHash(pRemoved);
+		m_CommandsByCharDirty = true;
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -864,6 +939,20 @@ void CConsole::DeregisterTemp(const char *pName)
 
 void CConsole::DeregisterTempAll()
 {
+	// drop temp entries from the index
+	for(int i = 0; i < COMMAND_HASH_SIZE; i++)
+	{
+		CCommand **ppLink = &m_apCommandHash[i];
+		while(*ppLink)
+		{
+			if((*ppLink)->m_Temp)
+				*ppLink = (*ppLink)->m_pNextHash;
+			else
+				ppLink = &(*ppLink)->m_pNextHash;
+		}
+	}
+	m_CommandsByCharDirty = true;
+
 	// set non temp as first one
 	for(; m_pFirstCommand && m_pFirstCommand->m_Temp; m_pFirstCommand = m_pFirstCommand->m_pNext);
 
@@ -927,7 +1016,7 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp)
 		{
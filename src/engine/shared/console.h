@@ -12,6 +12,7 @@ class CConsole : public IConsole
 	{
 	public:
 		CCommand *m_pNext;
+		CCommand *m_pNextHash;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
@@ -37,6 +38,18 @@ class CConsole : public IConsole
 	bool m_StoreCommands;
 	const char *m_paStrokeStr[2];
 	CCommand *m_pFirstCommand;
+
+	// case insensitive name index, commands with the same name chain up
+	enum
+	{
+		COMMAND_HASH_SIZE=512,
+	};
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
+
+	// first command in the sorted list per leading character, rebuilt on demand
+	CCommand *m_apCommandsByChar[256];
+	bool m_CommandsByCharDirty;
+
 	class CExecFile
 	{
 	public:
@@ -153,6 +166,10 @@ class CConsole : public IConsole
 
 	void AddCommandSorted(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
+	static unsigned CommandHash(const char *pName);
+	void AddCommandHash(CCommand *pCommand);
+	void RemoveCommandHash(CCommand *pCommand);
+	void UpdateCommandsByChar();
 
 public:
 	CConsole(int FlagMask);
@@ -160,6 +177,7 @@ public:
 	virtual const CCommandInfo *FirstCommandInfo(int AccessLevel, int FlagMask) const;
 	virtual const CCommandInfo *GetCommandInfo(const char *pName, int FlagMask, bool Temp);
 	virtual void PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPossibleCallback pfnCallback, void *pUser);
+	virtual void PossibleCommandsPrefix(const char *pPrefix, int FlagMask, bool Temp, FPossibleCallback pfnCallback, void *pUser);
 
 	virtual void ParseArguments(int NumArgs, const char **ppArguments);
 	virtual void Register(const char *pName, const char *pParams, int Flags, FCommandCallback pfnFunc, void *pUser, const char *pHelp);
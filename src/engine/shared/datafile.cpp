@@ -62,13 +62,107 @@ struct CDatafile
 {
 	IOHANDLE m_File;
 	unsigned m_Crc;
+	bool m_CrcValid;
 	CDatafileInfo m_Info;
 	CDatafileHeader m_Header;
 	int m_DataStartOffset;
 	char **m_ppDataPtrs;
 	char *m_pData;
+
+	// complete file image, only used by mapped readers
+	unsigned char *m_pImage;
+	unsigned m_ImageSize;
+	bool m_ImageMapped; // false if the image had to be read into memory
 };
 
+static bool CheckHeader(CDatafileHeader *pHeader)
+{
+	if(pHeader->m_aID[0] != 'A' || pHeader->m_aID[1] != 'T' || pHeader->m_aID[2] != 'A' || pHeader->m_aID[3] != 'D')
+	{
+		if(pHeader->m_aID[0] != 'D' || pHeader->m_aID[1] != 'A' || pHeader->m_aID[2] != 'T' || pHeader->m_aID[3] != 'A')
+		{
+			dbg_msg("datafile", "wrong signature. %x %x %x %x", pHeader->m_aID[0], pHeader->m_aID[1], pHeader->m_aID[2], pHeader->m_aID[3]);
+			return false;
+		}
+	}
+
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	swap_endian(pHeader, sizeof(int), sizeof(CDatafileHeader)/sizeof(int));
+#endif
+	if(pHeader->m_Version != 3 && pHeader->m_Version != 4)
+	{
+		dbg_msg("datafile", "wrong version. version=%x", pHeader->m_Version);
+		return false;
+	}
+	return true;
+}
+
+// size of the types, offsets, sizes and item data that follow the header
+static unsigned HeaderDataSize(const CDatafileHeader *pHeader)
+{
+	unsigned Size = 0;
+	Size += pHeader->m_NumItemTypes*sizeof(CDatafileItemType);
+	Size += (pHeader->m_NumItems+pHeader->m_NumRawData)*sizeof(int);
+	if(pHeader->m_Version == 4)
+		Size += pHeader->m_NumRawData*sizeof(int); // v4 has uncompressed data sizes aswell
+	Size += pHeader->m_ItemSize;
+	return Size;
+}
+
+static CDatafile *AllocDatafile(const CDatafileHeader *pHeader, unsigned Size)
+{
+	unsigned AllocSize = Size;
+	AllocSize += sizeof(CDatafile); // add space for info structure
+	AllocSize += pHeader->m_NumRawData*sizeof(void*); // add space for data pointers
+
+	dbg_msg("datafile", "allocsize=%d", AllocSize);
+
+	CDatafile *pDataFile = (CDatafile*)mem_alloc(AllocSize, 1);
+	pDataFile->m_Header = *pHeader;
+	pDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
+	pDataFile->m_ppDataPtrs = (char**)(pDataFile+1);
+	pDataFile->m_pData = (char *)(pDataFile+1)+pHeader->m_NumRawData*sizeof(char *);
+	pDataFile->m_File = 0;
+	pDataFile->m_Crc = 0;
+	pDataFile->m_CrcValid = false;
+	pDataFile->m_pImage = 0;
+	pDataFile->m_ImageSize = 0;
+	pDataFile->m_ImageMapped = false;
+
+	// clear the data pointers
+	mem_zero(pDataFile->m_ppDataPtrs, pHeader->m_NumRawData*sizeof(void*));
+	return pDataFile;
+}
+
+static void InitDatafileInfo(CDatafile *pDataFile, unsigned Size)
+{
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	swap_endian(pDataFile->m_pData, sizeof(int), min(static_cast<unsigned>(pDataFile->m_Header.m_Swaplen), Size) / sizeof(int));
+#endif
+
+	dbg_msg("datafile", "swaplen=%d", pDataFile->m_Header.m_Swaplen);
+	dbg_msg("datafile", "item_size=%d", pDataFile->m_Header.m_ItemSize);
+
+	pDataFile->m_Info.m_pItemTypes = (CDatafileItemType *)pDataFile->m_pData;
+	pDataFile->m_Info.m_pItemOffsets = (int *)&pDataFile->m_Info.m_pItemTypes[pDataFile->m_Header.m_NumItemTypes];
+	pDataFile->m_Info.m_pDataOffsets = (int *)&pDataFile->m_Info.m_pItemOffsets[pDataFile->m_Header.m_NumItems];
+	pDataFile->m_Info.m_pDataSizes = (int *)&pDataFile->m_Info.m_pDataOffsets[pDataFile->m_Header.m_NumRawData];
+
+	if(pDataFile->m_Header.m_Version == 4)
+		pDataFile->m_Info.m_pItemStart = (char *)&pDataFile->m_Info.m_pDataSizes[pDataFile->m_Header.m_NumRawData];
+	else
+		pDataFile->m_Info.m_pItemStart = (char *)&pDataFile->m_Info.m_pDataOffsets[pDataFile->m_Header.m_NumRawData];
+	pDataFile->m_Info.m_pDataStart = pDataFile->m_Info.m_pItemStart + pDataFile->m_Header.m_ItemSize;
+}
+
+static void FreeImage(unsigned char *pImage, unsigned Size, bool Mapped)
+{
+	if(Mapped)
+		io_unmap(pImage, Size);
+	else
+		mem_free(pImage);
+}
+
 bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
 {
 	dbg_msg("datafile", "loading. filename='%s'", pFilename);
@@ -106,46 +200,18 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	// TODO: change this header
 	CDatafileHeader Header;
 	io_read(File, &Header, sizeof(Header));
-	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
-	{
-		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
-		{
-			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
-			return 0;
-		}
-	}
-
-#if defined(CONF_ARCH_ENDIAN_BIG)
-	swap_endian(&Header, sizeof(int), sizeof(Header)/sizeof(int));
-#endif
-	if(Header.m_Version != 3 && Header.m_Version != 4)
+	if(!CheckHeader(&Header))
 	{
-		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
-		return 0;
+		io_close(File);
+		return false;
 	}
 
 	// read in the rest except the data
-	unsigned Size = 0;
-	Size += Header.m_NumItemTypes*sizeof(CDatafileItemType);
-	Size += (Header.m_NumItems+Header.m_NumRawData)*sizeof(int);
-	if(Header.m_Version == 4)
-		Size += Header.m_NumRawData*sizeof(int); // v4 has uncompressed data sizes aswell
-	Size += Header.m_ItemSize;
-
-	unsigned AllocSize = Size;
-	AllocSize += sizeof(CDatafile); // add space for info structure
-	AllocSize += Header.m_NumRawData*sizeof(void*); // add space for data pointers
-
-	CDatafile *pTmpDataFile = (CDatafile*)mem_alloc(AllocSize, 1);
-	pTmpDataFile->m_Header = Header;
-	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
-	pTmpDataFile->m_ppDataPtrs = (char**)(pTmpDataFile+1);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile+1)+Header.m_NumRawData*sizeof(char *);
+	unsigned Size = HeaderDataSize(&Header);
+	CDatafile *pTmpDataFile = AllocDatafile(&Header, Size);
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_Crc = Crc;
-
-	// clear the data pointers
-	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData*sizeof(void*));
+	pTmpDataFile->m_CrcValid = true;
 
 	// read types, offsets, sizes and item data
 	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
@@ -160,29 +226,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	Close();
 	m_pDataFile = pTmpDataFile;
-
-#if defined(CONF_ARCH_ENDIAN_BIG)
-	swap_endian(m_pDataFile->m_pData, sizeof(int), min(static_cast<unsigned>(Header.m_Swaplen), Size) / sizeof(int));
-#endif
-
-	//if(DEBUG)
-	{
-		dbg_msg("datafile", "allocsize=%d", AllocSize);
-		dbg_msg("datafile", "readsize=%d", ReadSize);
-		dbg_msg("datafile", "swaplen=%d", Header.m_Swaplen);
-		dbg_msg("datafile", "item_size=%d", m_pDataFile->m_Header.m_ItemSize);
-	}
-
-	m_pDataFile->m_Info.m_pItemTypes = (CDatafileItemType *)m_pDataFile->m_pData;
-	m_pDataFile->m_Info.m_pItemOffsets = (int *)&m_pDataFile->m_Info.m_pItemTypes[m_pDataFile->m_Header.m_NumItemTypes];
-	m_pDataFile->m_Info.m_pDataOffsets = (int *)&m_pDataFile->m_Info.m_pItemOffsets[m_pDataFile->m_Header.m_NumItems];
-	m_pDataFile->m_Info.m_pDataSizes = (int *)&m_pDataFile->m_Info.m_pDataOffsets[m_pDataFile->m_Header.m_NumRawData];
-
-	if(Header.m_Version == 4)
-		m_pDataFile->m_Info.m_pItemStart = (char *)&m_pDataFile->m_Info.m_pDataSizes[m_pDataFile->m_Header.m_NumRawData];
-	else
-		m_pDataFile->m_Info.m_pItemStart = (char *)&m_pDataFile->m_Info.m_pDataOffsets[m_pDataFile->m_Header.m_NumRawData];
-	m_pDataFile->m_Info.m_pDataStart = m_pDataFile->m_Info.m_pItemStart + m_pDataFile->m_Header.m_ItemSize;
+	InitDatafileInfo(m_pDataFile, Size);
 
 	dbg_msg("datafile", "loading done. datafile='%s'", pFilename);
 
@@ -225,6 +269,95 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	return true;
 }
 
+bool CDataFileReader::OpenMapped(class IStorage *pStorage, const char *pFilename, int StorageType)
+{
+	dbg_msg("datafile", "loading mapped. filename='%s'", pFilename);
+
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	if(!File)
+	{
+		dbg_msg("datafile", "could not open '%s'", pFilename);
+		return false;
+	}
+
+	long FileLength = io_length(File);
+	if(FileLength < (long)sizeof(CDatafileHeader))
+	{
+		io_close(File);
+		dbg_msg("datafile", "file too small. size=%d", (int)FileLength);
+		return false;
+	}
+	unsigned FileSize = (unsigned)FileLength;
+
+	// map the whole file, or read it in one go if mapping isn't available
+	bool Mapped = true;
+	unsigned char *pImage = (unsigned char *)io_map(File, FileSize);
+	if(!pImage)
+	{
+		Mapped = false;
+		pImage = (unsigned char *)mem_alloc(FileSize, 1);
+		unsigned ReadSize = io_read(File, pImage, FileSize);
+		if(ReadSize != FileSize)
+		{
+			io_close(File);
+			mem_free(pImage);
+			dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", FileSize, ReadSize);
+			return false;
+		}
+	}
+	io_close(File);
+
+	if(!OpenImage(pImage, FileSize, Mapped))
+		return false;
+
+	dbg_msg("datafile", "loading done. datafile='%s' size=%d mapped=%d", pFilename, FileSize, Mapped);
+	return true;
+}
+
+bool CDataFileReader::OpenMem(unsigned char *pData, unsigned Size)
+{
+	dbg_msg("datafile", "loading from memory. size=%d", Size);
+
+	if(Size < sizeof(CDatafileHeader))
+	{
+		mem_free(pData);
+		dbg_msg("datafile", "file too small. size=%d", Size);
+		return false;
+	}
+	return OpenImage(pData, Size, false);
+}
+
+bool CDataFileReader::OpenImage(unsigned char *pImage, unsigned FileSize, bool Mapped)
+{
+	CDatafileHeader Header;
+	mem_copy(&Header, pImage, sizeof(Header));
+	if(!CheckHeader(&Header))
+	{
+		FreeImage(pImage, FileSize, Mapped);
+		return false;
+	}
+
+	unsigned Size = HeaderDataSize(&Header);
+	if(sizeof(CDatafileHeader) + Size > FileSize || (unsigned)Header.m_DataSize > FileSize - sizeof(CDatafileHeader) - Size)
+	{
+		FreeImage(pImage, FileSize, Mapped);
+		dbg_msg("datafile", "file truncated. size=%d", FileSize);
+		return false;
+	}
+
+	// the item data is copied so that the image itself stays untouched (crc, downloads)
+	CDatafile *pTmpDataFile = AllocDatafile(&Header, Size);
+	mem_copy(pTmpDataFile->m_pData, pImage+sizeof(CDatafileHeader), Size);
+	pTmpDataFile->m_pImage = pImage;
+	pTmpDataFile->m_ImageSize = FileSize;
+	pTmpDataFile->m_ImageMapped = Mapped;
+
+	Close();
+	m_pDataFile = pTmpDataFile;
+	InitDatafileInfo(m_pDataFile, Size);
+	return true;
+}
+
 bool CDataFileReader::GetCrcSize(class IStorage *pStorage, const char *pFilename, int StorageType, unsigned *pCrc, unsigned *pSize)
 {
 	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
@@ -280,7 +413,36 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		int SwapSize = DataSize;
 #endif
 
-		if(m_pDataFile->m_Header.m_Version == 4)
+		if(m_pDataFile->m_pImage)
+		{
+			// decompress or copy straight out of the file image
+			int Offset = m_pDataFile->m_Info.m_pDataOffsets[Index];
+			if(Offset < 0 || DataSize < 0 || Offset+DataSize > m_pDataFile->m_Header.m_DataSize)
+			{
+				dbg_msg("datafile", "invalid data index=%d offset=%d size=%d", Index, Offset, DataSize);
+				return 0;
+			}
+			const unsigned char *pSrc = m_pDataFile->m_pImage+m_pDataFile->m_DataStartOffset+Offset;
+			if(m_pDataFile->m_Header.m_Version == 4)
+			{
+				unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
+				unsigned long s = UncompressedSize;
+
+				dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, (int)UncompressedSize);
+				m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize, 1);
+				uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (const Bytef*)pSrc, DataSize); // ignore_convention
+#if defined(CONF_ARCH_ENDIAN_BIG)
+				SwapSize = s;
+#endif
+			}
+			else
+			{
+				dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
+				m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize, 1);
+				mem_copy(m_pDataFile->m_ppDataPtrs[Index], pSrc, DataSize);
+			}
+		}
+		else if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
 			void *pTemp = (char *)mem_alloc(DataSize, 1);
@@ -413,7 +575,10 @@ bool CDataFileReader::Close()
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 		mem_free(m_pDataFile->m_ppDataPtrs[i]);
 
-	io_close(m_pDataFile->m_File);
+	if(m_pDataFile->m_File)
+		io_close(m_pDataFile->m_File);
+	if(m_pDataFile->m_pImage)
+		FreeImage(m_pDataFile->m_pImage, m_pDataFile->m_ImageSize, m_pDataFile->m_ImageMapped);
 	mem_free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
@@ -422,13 +587,36 @@ bool CDataFileReader::Close()
 unsigned CDataFileReader::Crc()
 {
 	if(!m_pDataFile) return 0xFFFFFFFF;
+
+	// mapped files compute their crc on first use
+	if(!m_pDataFile->m_CrcValid && m_pDataFile->m_pImage)
+	{
+		m_pDataFile->m_Crc = crc32(0, m_pDataFile->m_pImage, m_pDataFile->m_ImageSize); // ignore_convention
+		m_pDataFile->m_CrcValid = true;
+	}
 	return m_pDataFile->m_Crc;
 }
 
+const unsigned char *CDataFileReader::GetFileData() const
+{
+	if(!m_pDataFile) return 0;
+	return m_pDataFile->m_pImage;
+}
+
+unsigned CDataFileReader::GetFileSize() const
+{
+	if(!m_pDataFile) return 0;
+	return m_pDataFile->m_ImageSize;
+}
+
 
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_ToMemory = false;
+	m_pMemData = 0;
+	m_MemSize = 0;
+	m_MemCapacity = 0;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(mem_alloc(sizeof(CItemTypeInfo) * MAX_ITEM_TYPES, 1));
 	m_pItems = static_cast<CItemInfo *>(mem_alloc(sizeof(CItemInfo) * MAX_ITEMS, 1));
 	m_pDatas = static_cast<CDataInfo *>(mem_alloc(sizeof(CDataInfo) * MAX_DATAS, 1));
@@ -442,15 +630,74 @@ CDataFileWriter::~CDataFileWriter()
 	m_pItems = 0;
 	mem_free(m_pDatas);
 	m_pDatas = 0;
+	if(m_pMemData)
+		mem_free(m_pMemData);
+	m_pMemData = 0;
 }
 
 bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename)
 {
-	dbg_assert(!m_File, "a file already exists");
+	dbg_assert(!IsOpen(), "a file already exists");
 	m_File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 	if(!m_File)
 		return false;
 
+	Reset();
+	return true;
+}
+
+bool CDataFileWriter::OpenMem()
+{
+	dbg_assert(!IsOpen(), "a file already exists");
+	m_ToMemory = true;
+	if(m_pMemData)
+		mem_free(m_pMemData);
+	m_pMemData = 0;
+	m_MemSize = 0;
+	m_MemCapacity = 0;
+
+	Reset();
+	return true;
+}
+
+unsigned char *CDataFileWriter::TakeMemData(unsigned *pSize)
+{
+	unsigned char *pData = m_pMemData;
+	*pSize = m_MemSize;
+	m_pMemData = 0;
+	m_MemSize = 0;
+	m_MemCapacity = 0;
+	return pData;
+}
+
+void CDataFileWriter::Write(const void *pData, unsigned Size)
+{
+	if(m_File)
+	{
+		io_write(m_File, pData, Size);
+		return;
+	}
+
+	if(m_MemSize+Size > m_MemCapacity)
+	{
+		unsigned NewCapacity = max(m_MemCapacity*2, 64u*1024);
+		while(NewCapacity < m_MemSize+Size)
+			NewCapacity *= 2;
+		unsigned char *pNewData = (unsigned char *)mem_alloc(NewCapacity, 1);
+		if(m_pMemData)
+		{
+			mem_copy(pNewData, m_pMemData, m_MemSize);
+			mem_free(m_pMemData);
+		}
+		m_pMemData = pNewData;
+		m_MemCapacity = NewCapacity;
+	}
+	mem_copy(m_pMemData+m_MemSize, pData, Size);
+	m_MemSize += Size;
+}
+
+void CDataFileWriter::Reset()
+{
 	m_NumItems = 0;
 	m_NumDatas = 0;
 	m_NumItemTypes = 0;
@@ -461,13 +708,11 @@ bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename)
 		m_pItemTypes[i].m_First = -1;
 		m_pItemTypes[i].m_Last = -1;
 	}
-
-	return true;
 }
 
 int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 {
-	if(!m_File) return 0;
+	if(!IsOpen()) return 0;
 
 	dbg_assert(Type >= 0 && Type < 0xFFFF, "incorrect type");
 	dbg_assert(m_NumItems < 1024, "too many items");
@@ -503,7 +748,7 @@ int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 
 int CDataFileWriter::AddData(int Size, void *pData)
 {
-	if(!m_File) return 0;
+	if(!IsOpen()) return 0;
 
 	dbg_assert(m_NumDatas < 1024, "too much data");
 
@@ -547,7 +792,7 @@ int CDataFileWriter::AddDataSwapped(int Size, void *pData)
 
 int CDataFileWriter::Finish()
 {
-	if(!m_File) return 1;
+	if(!IsOpen()) return 1;
 
 	int ItemSize = 0;
 	int TypesSize, HeaderSize, OffsetSize, FileSize, SwapSize;
@@ -603,7 +848,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		swap_endian(&Header, sizeof(int), sizeof(Header)/sizeof(int));
 #endif
-		io_write(m_File, &Header, sizeof(Header));
+		Write(&Header, sizeof(Header));
 	}
 
 	// write types
@@ -621,7 +866,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 			swap_endian(&Info, sizeof(int), sizeof(CDatafileItemType)/sizeof(int));
 #endif
-			io_write(m_File, &Info, sizeof(Info));
+			Write(&Info, sizeof(Info));
 			Count += m_pItemTypes[i].m_Num;
 		}
 	}
@@ -641,7 +886,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 				swap_endian(&Temp, sizeof(int), sizeof(Temp)/sizeof(int));
 #endif
-				io_write(m_File, &Temp, sizeof(Temp));
+				Write(&Temp, sizeof(Temp));
 				Offset += m_pItems[k].m_Size + sizeof(CDatafileItem);
 
 				// next
@@ -659,7 +904,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		swap_endian(&Temp, sizeof(int), sizeof(Temp)/sizeof(int));
 #endif
-		io_write(m_File, &Temp, sizeof(Temp));
+		Write(&Temp, sizeof(Temp));
 		Offset += m_pDatas[i].m_CompressedSize;
 	}
 
@@ -672,7 +917,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		swap_endian(&UncompressedSize, sizeof(int), sizeof(UncompressedSize)/sizeof(int));
 #endif
-		io_write(m_File, &UncompressedSize, sizeof(UncompressedSize));
+		Write(&UncompressedSize, sizeof(UncompressedSize));
 	}
 
 	// write m_pItems
@@ -694,8 +939,8 @@ int CDataFileWriter::Finish()
 				swap_endian(&Item, sizeof(int), sizeof(Item)/sizeof(int));
 				swap_endian(m_pItems[k].m_pData, sizeof(int), m_pItems[k].m_Size/sizeof(int));
 #endif
-				io_write(m_File, &Item, sizeof(Item));
-				io_write(m_File, m_pItems[k].m_pData, m_pItems[k].m_Size);
+				Write(&Item, sizeof(Item));
+				Write(m_pItems[k].m_pData, m_pItems[k].m_Size);
 
 				// next
 				k = m_pItems[k].m_Next;
@@ -708,7 +953,7 @@ int CDataFileWriter::Finish()
 	{
 		if(DEBUG)
 			dbg_msg("datafile", "writing data id=%d size=%d", i, m_pDatas[i].m_CompressedSize);
-		io_write(m_File, m_pDatas[i].m_pCompressedData, m_pDatas[i].m_CompressedSize);
+		Write(m_pDatas[i].m_pCompressedData, m_pDatas[i].m_CompressedSize);
 	}
 
 	// free data
@@ -717,8 +962,10 @@ int CDataFileWriter::Finish()
 	for(int i = 0; i < m_NumDatas; ++i)
 		mem_free(m_pDatas[i].m_pCompressedData);
 
-	io_close(m_File);
+	if(m_File)
+		io_close(m_File);
 	m_File = 0;
+	m_ToMemory = false;
 
 	if(DEBUG)
 		dbg_msg("datafile", "done");
@@ -729,7 +976,6 @@ int CDataFileWriter::Finish()
 bool CDataFileWriter::SaveMap(class IStorage *pStorage, CDataFileReader *pFileMap, const char *pFileName, char *pBlocksData, int BlocksDataSize)
 {
 	dbg_msg("CDataFileWriter", "saving to '%s'...", pFileName);
-	char aBuf[128];
 
 	if(!Open(pStorage, pFileName))
 	{
@@ -737,6 +983,31 @@ bool CDataFileWriter::SaveMap(class IStorage *pStorage, CDataFileReader *pFileMa
 		return 0;
 	}
 
+	AddMapItems(pFileMap);
+
+	// finish the data file
+	Finish();
+	dbg_msg("CDataFileWriter", "saving done");
+
+	return true;
+}
+
+bool CDataFileWriter::SaveMapToMemory(CDataFileReader *pFileMap, unsigned char **ppData, unsigned *pSize)
+{
+	dbg_msg("CDataFileWriter", "saving to memory...");
+
+	OpenMem();
+	AddMapItems(pFileMap);
+	Finish();
+	*ppData = TakeMemData(pSize);
+
+	dbg_msg("CDataFileWriter", "saving done. size=%d", *pSize);
+	return *ppData != 0;
+}
+
+void CDataFileWriter::AddMapItems(CDataFileReader *pFileMap)
+{
+	char aBuf[128];
 
 	// save version
 	{
@@ -747,6 +1018,7 @@ bool CDataFileWriter::SaveMap(class IStorage *pStorage, CDataFileReader *pFileMa
 
 
 	// save map info
+	if(pFileMap->FindItem(MAPITEMTYPE_INFO, 0))
 	{
         CMapItemInfo Item = *((CMapItemInfo *)pFileMap->FindItem(MAPITEMTYPE_INFO, 0));
 		if(Item.m_Version == 1)
@@ -898,12 +1170,6 @@ bool CDataFileWriter::SaveMap(class IStorage *pStorage, CDataFileReader *pFileMa
 		int TotalSizePoints = sizeof(CEnvPoint)*Count;
 		AddItem(MAPITEMTYPE_ENVPOINTS, 0, TotalSizePoints, pPoints);
 	}
-
-	// finish the data file
-	Finish();
-	dbg_msg("CDataFileWriter", "saving done");
-
-	return true;
 }
 
 bool CDataFileWriter::CreateEmptyMap(class IStorage *pStorage, const char *pFileName, int w, int h, CImageInfoFile *pTileset)
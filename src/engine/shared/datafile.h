@@ -38,6 +38,7 @@ class CDataFileReader
 {
 	struct CDatafile *m_pDataFile;
 	void *GetDataImpl(int Index, int Swap);
+	bool OpenImage(unsigned char *pImage, unsigned Size, bool Mapped);
 public:
 	CDataFileReader() : m_pDataFile(0) {}
 	~CDataFileReader() { Close(); }
@@ -45,6 +46,10 @@ public:
 	bool IsOpen() const { return m_pDataFile != 0; }
 
 	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// maps the whole file, the crc is computed on demand and data is decompressed straight from the mapping
+	bool OpenMapped(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// takes ownership of a complete datafile image allocated with mem_alloc
+	bool OpenMem(unsigned char *pData, unsigned Size);
 	bool Close();
 
 	static bool GetCrcSize(class IStorage *pStorage, const char *pFilename, int StorageType, unsigned *pCrc, unsigned *pSize);
@@ -62,6 +67,10 @@ public:
 	void Unload();
 
 	unsigned Crc();
+
+	// raw file contents, only available when opened with OpenMapped or OpenMem
+	const unsigned char *GetFileData() const;
+	unsigned GetFileSize() const;
 };
 
 // write access
@@ -99,6 +108,10 @@ class CDataFileWriter
 	};
 
 	IOHANDLE m_File;
+	bool m_ToMemory;
+	unsigned char *m_pMemData;
+	unsigned m_MemSize;
+	unsigned m_MemCapacity;
 	int m_NumItems;
 	int m_NumDatas;
 	int m_NumItemTypes;
@@ -106,10 +119,18 @@ class CDataFileWriter
 	CItemInfo *m_pItems;
 	CDataInfo *m_pDatas;
 
+	bool IsOpen() const { return m_File != 0 || m_ToMemory; }
+	void Reset();
+	void Write(const void *pData, unsigned Size);
+	void AddMapItems(CDataFileReader *pFileMap);
+
 public:
 	CDataFileWriter();
 	~CDataFileWriter();
 	bool Open(class IStorage *pStorage, const char *Filename);
+	// writes into a growing memory buffer, fetch it with TakeMemData after Finish
+	bool OpenMem();
+	unsigned char *TakeMemData(unsigned *pSize);
 	int AddData(int Size, void *pData);
 	int AddDataSwapped(int Size, void *pData);
 	int AddItem(int Type, int ID, int Size, void *pData);
@@ -118,6 +139,7 @@ public:
 	// MapGen
 	bool CreateEmptyMap(class IStorage *pStorage, const char *pFileName, int w, int h, CImageInfoFile *pTileset = 0x0);
 	bool SaveMap(class IStorage *pStorage, CDataFileReader *pFileMap, const char *pFileName, char *pBlocksData = 0x0, int BlocksDataSize = 0);
+	bool SaveMapToMemory(CDataFileReader *pFileMap, unsigned char **ppData, unsigned *pSize);
 };
 
 
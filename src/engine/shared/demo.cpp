@@ -24,10 +24,24 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
 	m_File = 0;
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
+
+	m_pWriterThread = 0;
+	m_QueueLock = lock_create();
+	semaphore_init(&m_QueueSem);
+	m_StopWriter = false;
+	mem_zero(&m_Stats, sizeof(m_Stats));
+}
+
+CDemoRecorder::~CDemoRecorder()
+{
+	Stop();
+	semaphore_destroy(&m_QueueSem);
+	lock_destroy(m_QueueLock);
 }
 
 // Record
-int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, unsigned Crc, const char *pType)
+int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, unsigned Crc, const char *pType,
+	const unsigned char *pMapData, unsigned MapDataSize)
 {
 	CDemoHeader Header;
 	CTimelineMarkers TimelineMarkers;
@@ -36,18 +50,22 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 
 	m_pConsole = pConsole;
 
-	// open mapfile
+	// open mapfile, unless the caller already has it in memory
 	char aMapFilename[128];
-	// try the normal maps folder
-	str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pMap);
-	IOHANDLE MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_READ, IStorage::TYPE_ALL);
-	if(!MapFile)
+	IOHANDLE MapFile = 0;
+	if(!pMapData)
+	{
+		// try the normal maps folder
+		str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pMap);
+		MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	}
+	if(!MapFile && !pMapData)
 	{
 		// try the downloaded maps
 		str_format(aMapFilename, sizeof(aMapFilename), "downloadedmaps/%s_%08x.map", pMap, Crc);
 		MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_READ, IStorage::TYPE_ALL);
 	}
-	if(!MapFile)
+	if(!MapFile && !pMapData)
 	{
 		// search for the map within subfolders
 		char aBuf[512];
@@ -55,7 +73,7 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 		if(pStorage->FindFile(aMapFilename, "maps", IStorage::TYPE_ALL, aBuf, sizeof(aBuf)))
 			MapFile = pStorage->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
 	}
-	if(!MapFile)
+	if(!MapFile && !pMapData)
 	{
 		char aBuf[256];
 		str_format(aBuf, sizeof(aBuf), "Unable to open mapfile '%s'", pMap);
@@ -66,7 +84,8 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	IOHANDLE DemoFile = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 	if(!DemoFile)
 	{
-		io_close(MapFile);
+		if(MapFile)
+			io_close(MapFile);
 		MapFile = 0;
 		char aBuf[256];
 		str_format(aBuf, sizeof(aBuf), "Unable to open '%s' for recording", pFilename);
@@ -80,7 +99,7 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	Header.m_Version = gs_ActVersion;
 	str_copy(Header.m_aNetversion, pNetVersion, sizeof(Header.m_aNetversion));
 	str_copy(Header.m_aMapName, pMap, sizeof(Header.m_aMapName));
-	unsigned MapSize = io_length(MapFile);
+	unsigned MapSize = pMapData ? MapDataSize : io_length(MapFile);
 	Header.m_aMapSize[0] = (MapSize>>24)&0xff;
 	Header.m_aMapSize[1] = (MapSize>>16)&0xff;
 	Header.m_aMapSize[2] = (MapSize>>8)&0xff;
@@ -96,15 +115,20 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	io_write(DemoFile, &TimelineMarkers, sizeof(TimelineMarkers)); // fill this on stop
 
 	// write map data
-	while(1)
+	if(pMapData)
+		io_write(DemoFile, pMapData, MapDataSize);
+	else
 	{
-		unsigned char aChunk[1024*64];
-		int Bytes = io_read(MapFile, &aChunk, sizeof(aChunk));
-		if(Bytes <= 0)
-			break;
-		io_write(DemoFile, &aChunk, Bytes);
+		while(1)
+		{
+			unsigned char aChunk[1024*64];
+			int Bytes = io_read(MapFile, &aChunk, sizeof(aChunk));
+			if(Bytes <= 0)
+				break;
+			io_write(DemoFile, &aChunk, Bytes);
+		}
+		io_close(MapFile);
 	}
-	io_close(MapFile);
 
 	m_LastKeyFrame = -1;
 	m_LastTickMarker = -1;
@@ -116,6 +140,12 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
 	m_File = DemoFile;
 
+	// start the writer
+	m_Queue.Init();
+	mem_zero(&m_Stats, sizeof(m_Stats));
+	m_StopWriter = false;
+	m_pWriterThread = thread_init(WriterThread, this);
+
 	return 0;
 }
 
@@ -147,34 +177,104 @@ enum
 	CHUNKFLAG_BIGSIZE = 0x10
 };
 
-void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
+int CDemoRecorder::TickMarker(int Tick, int Keyframe, unsigned char *pMarker) const
 {
 	if(m_LastTickMarker == -1 || Tick-m_LastTickMarker > 63 || Keyframe)
 	{
-		unsigned char aChunk[5];
-		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER;
-		aChunk[1] = (Tick>>24)&0xff;
-		aChunk[2] = (Tick>>16)&0xff;
-		aChunk[3] = (Tick>>8)&0xff;
-		aChunk[4] = (Tick)&0xff;
+		pMarker[0] = CHUNKTYPEFLAG_TICKMARKER;
+		pMarker[1] = (Tick>>24)&0xff;
+		pMarker[2] = (Tick>>16)&0xff;
+		pMarker[3] = (Tick>>8)&0xff;
+		pMarker[4] = (Tick)&0xff;
 
 		if(Keyframe)
-			aChunk[0] |= CHUNKTICKFLAG_KEYFRAME;
-
-		io_write(m_File, aChunk, sizeof(aChunk));
-	}
-	else
-	{
-		unsigned char aChunk[1];
-		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_LastTickMarker);
-		io_write(m_File, aChunk, sizeof(aChunk));
+			pMarker[0] |= CHUNKTICKFLAG_KEYFRAME;
+		return 5;
 	}
 
+	pMarker[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_LastTickMarker);
+	return 1;
+}
+
+void CDemoRecorder::CommitTickMarker(int Tick)
+{
 	m_LastTickMarker = Tick;
 	if(m_FirstTick < 0)
 		m_FirstTick = Tick;
 }
 
+bool CDemoRecorder::Queue(int Type, const void *pData, int Size, const unsigned char *pMarker, int MarkerSize)
+{
+	int ChunkSize = sizeof(CQueuedChunk)+Size;
+
+	// never wait for the writer, a full queue means the disk can't keep up
+	lock_wait(m_QueueLock);
+	CQueuedChunk *pChunk = m_Queue.Allocate(ChunkSize);
+	if(!pChunk)
+	{
+		lock_unlock(m_QueueLock);
+		return false;
+	}
+
+	pChunk->m_Type = Type;
+	pChunk->m_Size = Size;
+	pChunk->m_MarkerSize = MarkerSize;
+	if(MarkerSize)
+		mem_copy(pChunk->m_aMarker, pMarker, MarkerSize);
+	if(Size)
+		mem_copy(pChunk+1, pData, Size);
+
+	m_Stats.m_NumChunks++;
+	m_Stats.m_QueuedBytes += ChunkSize;
+	m_Stats.m_PeakQueuedBytes = max(m_Stats.m_PeakQueuedBytes, m_Stats.m_QueuedBytes);
+	lock_unlock(m_QueueLock);
+
+	semaphore_signal(&m_QueueSem);
+	return true;
+}
+
+void CDemoRecorder::WriterThread(void *pUser)
+{
+	CDemoRecorder *pSelf = (CDemoRecorder *)pUser;
+	static const int MAX_CHUNK_SIZE = sizeof(CQueuedChunk)+CSnapshot::MAX_SIZE+sizeof(int);
+	unsigned char *pBuffer = (unsigned char *)mem_alloc(MAX_CHUNK_SIZE, 1);
+	CQueuedChunk *pChunk = (CQueuedChunk *)pBuffer;
+
+	while(1)
+	{
+		semaphore_wait(&pSelf->m_QueueSem);
+
+		// drain everything that is queued
+		while(1)
+		{
+			lock_wait(pSelf->m_QueueLock);
+			CQueuedChunk *pFirst = pSelf->m_Queue.First();
+			if(!pFirst)
+			{
+				bool Stop = pSelf->m_StopWriter;
+				lock_unlock(pSelf->m_QueueLock);
+				if(Stop)
+				{
+					mem_free(pBuffer);
+					return;
+				}
+				break;
+			}
+
+			int ChunkSize = sizeof(CQueuedChunk)+pFirst->m_Size;
+			mem_copy(pChunk, pFirst, min(ChunkSize, MAX_CHUNK_SIZE));
+			pSelf->m_Queue.PopFirst();
+			pSelf->m_Stats.m_QueuedBytes -= ChunkSize;
+			lock_unlock(pSelf->m_QueueLock);
+
+			if(pChunk->m_MarkerSize)
+				io_write(pSelf->m_File, pChunk->m_aMarker, pChunk->m_MarkerSize);
+			if(pChunk->m_Type)
+				pSelf->Write(pChunk->m_Type, pChunk+1, pChunk->m_Size);
+		}
+	}
+}
+
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
 {
 	char aBuffer[64*1024];
@@ -221,13 +321,20 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 
 void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 {
+	if(!m_File)
+		return;
+
+	unsigned char aMarker[5];
 	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
 	{
-		// write full tickmarker
-		WriteTickMarker(Tick, 1);
-
-		// write snapshot
-		Write(CHUNKTYPE_SNAPSHOT, pData, Size);
+		// full tickmarker and snapshot
+		int MarkerSize = TickMarker(Tick, 1, aMarker);
+		if(!Queue(CHUNKTYPE_SNAPSHOT, pData, Size, aMarker, MarkerSize))
+		{
+			m_Stats.m_NumDroppedSnapshots++;
+			return;
+		}
+		CommitTickMarker(Tick);
 
 		m_LastKeyFrame = Tick;
 		mem_copy(m_aLastSnapshotData, pData, Size);
@@ -238,22 +345,39 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 		char aDeltaData[CSnapshot::MAX_SIZE+sizeof(int)];
 		int DeltaSize;
 
-		// write tickmarker
-		WriteTickMarker(Tick, 0);
+		int MarkerSize = TickMarker(Tick, 0, aMarker);
 
 		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aDeltaData);
 		if(DeltaSize)
 		{
-			// record delta
-			Write(CHUNKTYPE_DELTA, aDeltaData, DeltaSize);
+			// record delta, if it doesn't fit the next snapshot has to be a keyframe
+			if(!Queue(CHUNKTYPE_DELTA, aDeltaData, DeltaSize, aMarker, MarkerSize))
+			{
+				m_Stats.m_NumDroppedSnapshots++;
+				m_LastKeyFrame = -1;
+				return;
+			}
 			mem_copy(m_aLastSnapshotData, pData, Size);
 		}
+		else if(!Queue(0, 0, 0, aMarker, MarkerSize))
+			return;
+		CommitTickMarker(Tick);
 	}
 }
 
 void CDemoRecorder::RecordMessage(const void *pData, int Size)
 {
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	if(!m_File)
+		return;
+	if(!Queue(CHUNKTYPE_MESSAGE, pData, Size, 0, 0))
+		m_Stats.m_NumDroppedMessages++;
+}
+
+void CDemoRecorder::GetStats(CStats *pStats)
+{
+	lock_wait(m_QueueLock);
+	*pStats = m_Stats;
+	lock_unlock(m_QueueLock);
 }
 
 int CDemoRecorder::Stop()
@@ -261,6 +385,14 @@ int CDemoRecorder::Stop()
 	if(!m_File)
 		return -1;
 
+	// let the writer flush everything that is still queued
+	lock_wait(m_QueueLock);
+	m_StopWriter = true;
+	lock_unlock(m_QueueLock);
+	semaphore_signal(&m_QueueSem);
+	thread_wait(m_pWriterThread);
+	m_pWriterThread = 0;
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	int DemoLength = Length();
@@ -292,7 +424,11 @@ int CDemoRecorder::Stop()
 
 	io_close(m_File);
 	m_File = 0;
-	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Stopped recording");
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "Stopped recording. chunks=%d dropped_snapshots=%d dropped_messages=%d peak_queue=%dkb",
+		m_Stats.m_NumChunks, m_Stats.m_NumDroppedSnapshots, m_Stats.m_NumDroppedMessages, m_Stats.m_PeakQueuedBytes/1024);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
 
 	return 0;
 }
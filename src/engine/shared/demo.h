@@ -6,10 +6,36 @@
 #include <engine/demo.h>
 #include <engine/shared/protocol.h>
 
+#include "ringbuffer.h"
 #include "snapshot.h"
 
 class CDemoRecorder : public IDemoRecorder
 {
+public:
+	struct CStats
+	{
+		int m_NumChunks; // chunks handed to the writer thread
+		int m_NumDroppedSnapshots; // snapshots dropped because the queue was full
+		int m_NumDroppedMessages; // messages dropped because the queue was full
+		int m_QueuedBytes;
+		int m_PeakQueuedBytes;
+	};
+
+private:
+	enum
+	{
+		QUEUE_SIZE=1024*1024,
+	};
+
+	// queued chunk, followed by its data
+	struct CQueuedChunk
+	{
+		int m_Type;
+		int m_Size;
+		int m_MarkerSize;
+		unsigned char m_aMarker[5];
+	};
+
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
 	int m_LastTickMarker;
@@ -20,12 +46,25 @@ class CDemoRecorder : public IDemoRecorder
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 
-	void WriteTickMarker(int Tick, int Keyframe);
+	// encoding and disk io happen on a writer thread fed by a bounded queue
+	void *m_pWriterThread;
+	LOCK m_QueueLock;
+	SEMAPHORE m_QueueSem;
+	bool m_StopWriter;
+	TStaticRingBuffer<CQueuedChunk, QUEUE_SIZE> m_Queue;
+	CStats m_Stats;
+
+	int TickMarker(int Tick, int Keyframe, unsigned char *pMarker) const;
+	void CommitTickMarker(int Tick);
+	bool Queue(int Type, const void *pData, int Size, const unsigned char *pMarker, int MarkerSize);
 	void Write(int Type, const void *pData, int Size);
+	static void WriterThread(void *pUser);
 public:
 	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta);
+	~CDemoRecorder();
 
-	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType);
+	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType,
+		const unsigned char *pMapData = 0, unsigned MapSize = 0);
 	int Stop();
 	void AddDemoMarker();
 
@@ -35,6 +74,7 @@ public:
 	bool IsRecording() const { return m_File != 0; }
 
 	int Length() const { return (m_LastTickMarker - m_FirstTick)/SERVER_TICK_SPEED; }
+	void GetStats(CStats *pStats);
 };
 
 class CDemoPlayer : public IDemoPlayer
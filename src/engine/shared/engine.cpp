@@ -100,6 +100,13 @@ public:
 			dbg_logger_file(g_Config.m_Logfile);
 	}
 
+	void InitJobs()
+	{
+		// the pool starts with one worker for lookups, add the rest once the config is known
+		if(g_Config.m_JobThreads > m_JobPool.NumThreads())
+			m_JobPool.Init(g_Config.m_JobThreads - m_JobPool.NumThreads());
+	}
+
 	void HostLookup(CHostLookup *pLookup, const char *pHostname, int Nettype)
 	{
 		str_copy(pLookup->m_aHostname, pHostname, sizeof(pLookup->m_aHostname));
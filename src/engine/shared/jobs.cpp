@@ -3,73 +3,253 @@
 #include <base/system.h>
 #include "jobs.h"
 
+CJobGroup::CJobGroup()
+{
+	m_NumPending = 0;
+	m_Waiting = false;
+	m_pFirstDependent = 0;
+	semaphore_init(&m_Done);
+}
+
+CJobGroup::~CJobGroup()
+{
+	semaphore_destroy(&m_Done);
+}
+
 CJobPool::CJobPool()
 {
 	// empty the pool
 	m_Lock = lock_create();
-	m_pFirstJob = 0;
-	m_pLastJob = 0;
+	semaphore_init(&m_Pending);
+	for(int i = 0; i < MAX_THREADS; i++)
+	{
+		m_aQueues[i].m_Lock = lock_create();
+		m_aQueues[i].m_pFirstJob = 0;
+		m_aQueues[i].m_pLastJob = 0;
+		m_apThreads[i] = 0;
+	}
+	m_NumThreads = 0;
+	m_NextQueue = 0;
+	m_Shutdown = false;
+}
+
+CJobPool::~CJobPool()
+{
+	m_Shutdown = true;
+	for(int i = 0; i < m_NumThreads; i++)
+		semaphore_signal(&m_Pending);
+	for(int i = 0; i < m_NumThreads; i++)
+		thread_wait(m_apThreads[i]);
+
+	for(int i = 0; i < MAX_THREADS; i++)
+		lock_destroy(m_aQueues[i].m_Lock);
+	semaphore_destroy(&m_Pending);
+	lock_destroy(m_Lock);
 }
 
 void CJobPool::WorkerThread(void *pUser)
 {
-	CJobPool *pPool = (CJobPool *)pUser;
+	CWorker *pWorker = (CWorker *)pUser;
+	CJobPool *pPool = pWorker->m_pPool;
 
 	while(1)
 	{
+		// one signal per queued job, spurious wakeups are fine
+		semaphore_wait(&pPool->m_Pending);
+		if(pPool->m_Shutdown)
+			break;
+
+		CJob *pJob = pPool->Fetch(pWorker->m_Index, 0);
+		if(pJob)
+			pPool->Run(pJob);
+	}
+}
+
+void CJobPool::Push(CJob *pJob)
+{
+	// m_Lock must be held
+	CQueue *pQueue = &m_aQueues[m_NextQueue++ % NumQueues()];
+
+	lock_wait(pQueue->m_Lock);
+	pJob->m_pPrev = pQueue->m_pLastJob;
+	pJob->m_pNext = 0;
+	if(pQueue->m_pLastJob)
+		pQueue->m_pLastJob->m_pNext = pJob;
+	pQueue->m_pLastJob = pJob;
+	if(!pQueue->m_pFirstJob)
+		pQueue->m_pFirstJob = pJob;
+	lock_unlock(pQueue->m_Lock);
+
+	semaphore_signal(&m_Pending);
+}
+
+CJob *CJobPool::Fetch(int Queue, CJobGroup *pGroup)
+{
+	// own queue from the front, other queues are stolen from at the back.
+	// with a group only jobs of that group are taken
+	int Num = NumQueues();
+	for(int i = 0; i < Num; i++)
+	{
+		CQueue *pQueue = &m_aQueues[(Queue+i)%Num];
+		if(!pQueue->m_pFirstJob)
+			continue;
+
+		lock_wait(pQueue->m_Lock);
 		CJob *pJob = 0;
+		if(pGroup)
+		{
+			for(pJob = pQueue->m_pFirstJob; pJob && pJob->m_pGroup != pGroup; pJob = pJob->m_pNext);
+		}
+		else
+			pJob = i == 0 ? pQueue->m_pFirstJob : pQueue->m_pLastJob;
 
-		// fetch job from queue
-		lock_wait(pPool->m_Lock);
-		if(pPool->m_pFirstJob)
+		if(pJob)
 		{
-			pJob = pPool->m_pFirstJob;
-			pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-			if(pPool->m_pFirstJob)
-				pPool->m_pFirstJob->m_pPrev = 0;
+			if(pJob->m_pPrev)
+				pJob->m_pPrev->m_pNext = pJob->m_pNext;
+			else
+				pQueue->m_pFirstJob = pJob->m_pNext;
+			if(pJob->m_pNext)
+				pJob->m_pNext->m_pPrev = pJob->m_pPrev;
 			else
-				pPool->m_pLastJob = 0;
+				pQueue->m_pLastJob = pJob->m_pPrev;
+			pJob->m_pPrev = 0;
+			pJob->m_pNext = 0;
 		}
-		lock_unlock(pPool->m_Lock);
+		lock_unlock(pQueue->m_Lock);
 
-		// do the job if we have one
 		if(pJob)
+			return pJob;
+	}
+	return 0;
+}
+
+void CJobPool::Release(CJob *pFirst)
+{
+	// m_Lock must be held
+	while(pFirst)
+	{
+		CJob *pNext = pFirst->m_pNextDependent;
+		pFirst->m_pNextDependent = 0;
+		Push(pFirst);
+		pFirst = pNext;
+	}
+}
+
+void CJobPool::Run(CJob *pJob)
+{
+	pJob->m_Status = CJob::STATE_RUNNING;
+	int Result = pJob->m_pfnFunc(pJob->m_pFuncData);
+
+	lock_wait(m_Lock);
+	CJob *pDependents = pJob->m_pFirstDependent;
+	CJobGroup *pGroup = pJob->m_pGroup;
+	pJob->m_pFirstDependent = 0;
+	pJob->m_Result = Result;
+	// the owner may reuse or free the job from here on
+	pJob->m_Status = CJob::STATE_DONE;
+
+	Release(pDependents);
+	if(pGroup && --pGroup->m_NumPending == 0)
+	{
+		Release(pGroup->m_pFirstDependent);
+		pGroup->m_pFirstDependent = 0;
+		if(pGroup->m_Waiting)
 		{
-			pJob->m_Status = CJob::STATE_RUNNING;
-			pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
-			pJob->m_Status = CJob::STATE_DONE;
+			pGroup->m_Waiting = false;
+			semaphore_signal(&pGroup->m_Done);
 		}
-		else
-			thread_sleep(10);
 	}
-
+	lock_unlock(m_Lock);
 }
 
 int CJobPool::Init(int NumThreads)
 {
 	// start threads
-	for(int i = 0; i < NumThreads; i++)
-		thread_init(WorkerThread, this);
+	for(int i = 0; i < NumThreads && m_NumThreads < MAX_THREADS; i++)
+	{
+		CWorker *pWorker = &m_aWorkers[m_NumThreads];
+		pWorker->m_pPool = this;
+		pWorker->m_Index = m_NumThreads;
+		m_apThreads[m_NumThreads] = thread_init(WorkerThread, pWorker);
+		m_NumThreads++;
+	}
 	return 0;
 }
 
-int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData)
+int CJobPool::Submit(CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup, CJob *pAfterJob, CJobGroup *pAfterGroup)
 {
 	mem_zero(pJob, sizeof(CJob));
+	pJob->m_pPool = this;
 	pJob->m_pfnFunc = pfnFunc;
 	pJob->m_pFuncData = pData;
+	pJob->m_pGroup = pGroup;
 
 	lock_wait(m_Lock);
 
-	// add job to queue
-	pJob->m_pPrev = m_pLastJob;
-	if(m_pLastJob)
-		m_pLastJob->m_pNext = pJob;
-	m_pLastJob = pJob;
-	if(!m_pFirstJob)
-		m_pFirstJob = pJob;
+	if(pGroup)
+		pGroup->m_NumPending++;
+
+	// hold the job back until its dependency is done
+	if(pAfterJob && pAfterJob->m_Status != CJob::STATE_DONE)
+	{
+		pJob->m_pNextDependent = pAfterJob->m_pFirstDependent;
+		pAfterJob->m_pFirstDependent = pJob;
+	}
+	else if(pAfterGroup && pAfterGroup->m_NumPending > 0)
+	{
+		pJob->m_pNextDependent = pAfterGroup->m_pFirstDependent;
+		pAfterGroup->m_pFirstDependent = pJob;
+	}
+	else
+		Push(pJob);
 
 	lock_unlock(m_Lock);
 	return 0;
 }
 
+int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup)
+{
+	return Submit(pJob, pfnFunc, pData, pGroup, 0, 0);
+}
+
+int CJobPool::AddAfter(CJob *pDependency, CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup)
+{
+	return Submit(pJob, pfnFunc, pData, pGroup, pDependency, 0);
+}
+
+int CJobPool::AddAfter(CJobGroup *pDependency, CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup)
+{
+	return Submit(pJob, pfnFunc, pData, pGroup, 0, pDependency);
+}
+
+void CJobPool::Wait(CJobGroup *pGroup)
+{
+	while(1)
+	{
+		lock_wait(m_Lock);
+		bool Done = pGroup->m_NumPending == 0;
+		lock_unlock(m_Lock);
+		if(Done)
+			return;
+
+		// help out instead of idling, but only with our own jobs so
+		// a long running background job can't stall the caller
+		CJob *pJob = Fetch(0, pGroup);
+		if(pJob)
+		{
+			Run(pJob);
+			continue;
+		}
+
+		// everything left is running elsewhere or held back, sleep until the last one finishes
+		lock_wait(m_Lock);
+		Done = pGroup->m_NumPending == 0;
+		if(!Done)
+			pGroup->m_Waiting = true;
+		lock_unlock(m_Lock);
+		if(Done)
+			return;
+		semaphore_wait(&pGroup->m_Done);
+	}
+}
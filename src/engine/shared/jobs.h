@@ -5,6 +5,7 @@
 typedef int (*JOBFUNC)(void *pData);
 
 class CJobPool;
+class CJobGroup;
 
 class CJob
 {
@@ -14,6 +15,11 @@ class CJob
 	CJob *m_pPrev;
 	CJob *m_pNext;
 
+	// jobs waiting for this one to finish
+	CJob *m_pFirstDependent;
+	CJob *m_pNextDependent;
+	CJobGroup *m_pGroup;
+
 	volatile int m_Status;
 	volatile int m_Result;
 
@@ -37,18 +43,79 @@ public:
 	int Result() const {return m_Result; }
 };
 
+// a set of jobs that can be waited for as a whole,
+// or that later jobs can depend on
+class CJobGroup
+{
+	friend class CJobPool;
+
+	int m_NumPending;
+	bool m_Waiting;
+	SEMAPHORE m_Done;
+
+	// jobs waiting for the whole group to finish
+	CJob *m_pFirstDependent;
+
+public:
+	CJobGroup();
+	~CJobGroup();
+
+	bool Done() const { return m_NumPending == 0; }
+};
+
 class CJobPool
 {
+	enum
+	{
+		MAX_THREADS=16,
+	};
+
+	struct CQueue
+	{
+		LOCK m_Lock;
+		CJob *m_pFirstJob;
+		CJob *m_pLastJob;
+	};
+
+	// protects dependency and group bookkeeping
 	LOCK m_Lock;
-	CJob *m_pFirstJob;
-	CJob *m_pLastJob;
+	SEMAPHORE m_Pending;
+	CQueue m_aQueues[MAX_THREADS];
+	void *m_apThreads[MAX_THREADS];
+	volatile int m_NumThreads;
+	volatile int m_NextQueue;
+	volatile bool m_Shutdown;
+
+	struct CWorker
+	{
+		CJobPool *m_pPool;
+		int m_Index;
+	};
+	CWorker m_aWorkers[MAX_THREADS];
 
 	static void WorkerThread(void *pUser);
 
+	int NumQueues() const { return m_NumThreads > 0 ? m_NumThreads : 1; }
+	void Push(CJob *pJob);
+	CJob *Fetch(int Queue, CJobGroup *pGroup);
+	void Run(CJob *pJob);
+	void Release(CJob *pFirst);
+	int Submit(CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup, CJob *pAfterJob, CJobGroup *pAfterGroup);
+
 public:
 	CJobPool();
+	~CJobPool();
 
+	// can be called again later to add more workers
 	int Init(int NumThreads);
-	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData);
+	int NumThreads() const { return m_NumThreads; }
+
+	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup = 0);
+	// the job is queued once pDependency (or every job in pDependency) is done
+	int AddAfter(CJob *pDependency, CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup = 0);
+	int AddAfter(CJobGroup *pDependency, CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup = 0);
+
+	// blocks until every job in the group is done, running queued jobs meanwhile
+	void Wait(CJobGroup *pGroup);
 };
 #endif
@@ -29,7 +29,12 @@ public:
 		IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
 		if(!pStorage)
 			return false;
-		return m_DataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL);
+		return m_DataFile.OpenMapped(pStorage, pMapName, IStorage::TYPE_ALL);
+	}
+
+	virtual bool LoadFromMemory(unsigned char *pData, unsigned Size)
+	{
+		return m_DataFile.OpenMem(pData, Size);
 	}
 
 	virtual bool IsLoaded()
@@ -42,6 +47,16 @@ public:
 		return m_DataFile.Crc();
 	}
 
+	virtual const unsigned char *FileData()
+	{
+		return m_DataFile.GetFileData();
+	}
+
+	virtual unsigned FileSize()
+	{
+		return m_DataFile.GetFileSize();
+	}
+
 	virtual CDataFileReader* GetFileReader() { return &m_DataFile; } // MapGen
 };
 
@@ -106,7 +106,15 @@ void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *
 		mem_copy(aBuffer + sizeof(NET_HEADER_EXTENDED), aExtra, 4);
 	}
 	mem_copy(aBuffer + DATA_OFFSET, pData, DataSize);
-	net_udp_send(Socket, pAddr, aBuffer, DataSize + DATA_OFFSET);
+	SendRaw(Socket, pAddr, aBuffer, DataSize + DATA_OFFSET);
+}
+
+void CNetBase::SendRaw(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize)
+{
+	// fall back to a direct send if the queue is full
+	if(ms_pIOThread && ms_pIOThread->Owns(Socket) && ms_pIOThread->Send(pAddr, pData, DataSize))
+		return;
+	net_udp_send(Socket, pAddr, pData, DataSize);
 }
 
 void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket, SECURITY_TOKEN SecurityToken)
@@ -158,7 +166,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 		aBuffer[0] = ((pPacket->m_Flags<<4)&0xf0)|((pPacket->m_Ack>>8)&0xf);
 		aBuffer[1] = pPacket->m_Ack&0xff;
 		aBuffer[2] = pPacket->m_NumChunks;
-		net_udp_send(Socket, pAddr, aBuffer, FinalSize);
+		SendRaw(Socket, pAddr, aBuffer, FinalSize);
 
 		// log raw socket data
 		if(ms_DataLogSent)
@@ -315,6 +323,7 @@ int CNetBase::IsSeqInBackroom(int Seq, int Ack)
 IOHANDLE CNetBase::ms_DataLogSent = 0;
 IOHANDLE CNetBase::ms_DataLogRecv = 0;
 CHuffman CNetBase::ms_Huffman;
+CNetIOThread *CNetBase::ms_pIOThread = 0;
 
 
 void CNetBase::OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv)
@@ -42,7 +42,8 @@ enum
 	NETBANTYPE_SOFT=1,
 	NETBANTYPE_DROP=2,
 
-	NETCREATE_FLAG_RANDOMPORT=1
+	NETCREATE_FLAG_RANDOMPORT=1,
+	NETCREATE_FLAG_REUSEPORT=2
 };
 
 
@@ -168,6 +169,8 @@ private:
 	bool m_UnknownSeq;
 
 	TStaticRingBuffer<CNetChunkResend, NET_CONN_BUFFERSIZE> m_Buffer;
+	int m_NumBuffered;
+	int m_NumResends;
 
 	int64 m_LastUpdateTime;
 	int64 m_LastRecvTime;
@@ -224,6 +227,10 @@ public:
 
 	int AckSequence() const { return m_Ack; }
 
+	// vital chunks waiting for an ack, and chunks sent again so far
+	int ResendQueueDepth() const { return m_NumBuffered; }
+	int NumResends() const { return m_NumResends; }
+
 	// anti spoof
 	void DirectInit(NETADDR &Addr, SECURITY_TOKEN SecurityToken);
 	void SetUnknownSeq() { m_UnknownSeq = true; }
@@ -306,6 +313,7 @@ class CNetServer
 	int m_VConnNum;
 
 	CNetRecvUnpacker m_RecvUnpacker;
+	class CNetIOThread *m_pIOThread;
 
 	int m_NumConAttempts; // log flooding attacks
 	int64 m_TimeNumConAttempts;
@@ -342,6 +350,8 @@ public:
 	// status requests
 	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
 	bool HasSecurityToken(int ClientID) const { return m_aSlots[ClientID].m_Connection.SecurityToken() != NET_SECURITY_TOKEN_UNSUPPORTED; }	
+	int ResendQueueDepth(int ClientID) const { return m_aSlots[ClientID].m_Connection.ResendQueueDepth(); }
+	int NumResends(int ClientID) const { return m_aSlots[ClientID].m_Connection.NumResends(); }
 	NETSOCKET Socket() const { return m_Socket; }
 	class CNetBan *NetBan() const { return m_pNetBan; }
 	int NetType() const { return m_Socket.type; }
@@ -349,6 +359,7 @@ public:
 
 	//
 	void SetMaxClientsPerIP(int Max);
+	void SetIOThread(class CNetIOThread *pIOThread) { m_pIOThread = pIOThread; }
 
 	// anti spoof
 	SECURITY_TOKEN GetToken(const NETADDR &Addr);
@@ -400,6 +411,7 @@ class CNetBase
 	static IOHANDLE ms_DataLogSent;
 	static IOHANDLE ms_DataLogRecv;
 	static CHuffman ms_Huffman;
+	static class CNetIOThread *ms_pIOThread;
 public:
 	static void OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv);
 	static void CloseLog();
@@ -414,6 +426,76 @@ public:
 
 	// The backroom is ack-NET_MAX_SEQUENCE/2. Used for knowing if we acked a packet or not
 	static int IsSeqInBackroom(int Seq, int Ack);
+
+	// raw datagrams go through the network thread when one owns the socket
+	static void SetIOThread(class CNetIOThread *pIOThread) { ms_pIOThread = pIOThread; }
+	static void SendRaw(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize);
+};
+
+// receives, validates and unpacks datagrams and flushes outgoing ones on a
+// thread of its own. the queues are single producer/single consumer rings,
+// Recv, Send and WaitRecv may only be called from one (the game) thread
+class CNetIOThread
+{
+public:
+	enum
+	{
+		RECV_QUEUE_SIZE=1024,
+		SEND_QUEUE_SIZE=1024,
+	};
+
+private:
+	struct CRecvEntry
+	{
+		NETADDR m_Addr;
+		CNetPacketConstruct m_Packet;
+	};
+
+	struct CSendEntry
+	{
+		NETADDR m_Addr;
+		int m_Size;
+		unsigned char m_aData[NET_MAX_PACKETSIZE];
+	};
+
+	NETSOCKET m_Socket;
+	void *m_pThread;
+	volatile int m_Stop;
+
+	// the producer only moves the head, the consumer only the tail
+	CRecvEntry *m_pRecvQueue;
+	volatile int m_RecvHead;
+	volatile int m_RecvTail;
+	CSendEntry *m_pSendQueue;
+	volatile int m_SendHead;
+	volatile int m_SendTail;
+
+	SEMAPHORE m_RecvSignal;
+	volatile int m_RecvWaiting;
+
+	volatile int m_NumDropped;
+	volatile int m_NumSendOverflows;
+
+	int RecvQueued() const { return (m_RecvHead - m_RecvTail) & (RECV_QUEUE_SIZE-1); }
+	void FlushSends();
+	void ReceiveAll();
+	static void ThreadFunc(void *pUser);
+
+public:
+	CNetIOThread();
+	~CNetIOThread();
+
+	bool Start(NETSOCKET Socket);
+	void Stop();
+	bool Running() const { return m_pThread != 0; }
+	bool Owns(NETSOCKET Socket) const;
+
+	bool Recv(NETADDR *pAddr, CNetPacketConstruct *pPacket);
+	bool Send(const NETADDR *pAddr, const void *pData, int Size);
+	void WaitRecv(int Ms);
+
+	int NumDropped() const { return m_NumDropped; }
+	int NumSendOverflows() const { return m_NumSendOverflows; }
 };
 
 
@@ -39,6 +39,8 @@ void CNetConnection::Reset(bool Rejoin)
 	m_UnknownSeq = false;
 
 	m_Buffer.Init();
+	m_NumBuffered = 0;
+	m_NumResends = 0;
 
 	mem_zero(&m_Construct, sizeof(m_Construct));
 }
@@ -71,7 +73,10 @@ void CNetConnection::AckChunks(int Ack)
 			break;
 
 		if(CNetBase::IsSeqInBackroom(pResend->m_Sequence, Ack))
+		{
 			m_Buffer.PopFirst();
+			m_NumBuffered--;
+		}
 		else
 			break;
 	}
@@ -137,6 +142,7 @@ int CNetConnection::QueueChunkEx(int Flags, int DataSize, const void *pData, int
 			pResend->m_FirstSendTime = time_get();
 			pResend->m_LastSendTime = pResend->m_FirstSendTime;
 			mem_copy(pResend->m_pData, pData, DataSize);
+			m_NumBuffered++;
 		}
 		else
 		{
@@ -167,6 +173,7 @@ void CNetConnection::ResendChunk(CNetChunkResend *pResend)
 {
 	QueueChunkEx(pResend->m_Flags|NET_CHUNKFLAG_RESEND, pResend->m_DataSize, pResend->m_pData, pResend->m_Sequence);
 	pResend->m_LastSendTime = time_get();
+	m_NumResends++;
 }
 
 void CNetConnection::Resend()
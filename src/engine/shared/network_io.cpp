@@ -0,0 +1,202 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include "network.h"
+
+CNetIOThread::CNetIOThread()
+{
+	m_Socket.type = 0;
+	m_Socket.ipv4sock = -1;
+	m_Socket.ipv6sock = -1;
+	m_pThread = 0;
+	m_Stop = 0;
+	m_pRecvQueue = 0;
+	m_RecvHead = 0;
+	m_RecvTail = 0;
+	m_pSendQueue = 0;
+	m_SendHead = 0;
+	m_SendTail = 0;
+	m_RecvWaiting = 0;
+	m_NumDropped = 0;
+	m_NumSendOverflows = 0;
+}
+
+CNetIOThread::~CNetIOThread()
+{
+	Stop();
+}
+
+bool CNetIOThread::Start(NETSOCKET Socket)
+{
+	if(m_pThread)
+		return false;
+
+	m_pRecvQueue = (CRecvEntry *)mem_alloc(sizeof(CRecvEntry)*RECV_QUEUE_SIZE, 1);
+	m_pSendQueue = (CSendEntry *)mem_alloc(sizeof(CSendEntry)*SEND_QUEUE_SIZE, 1);
+	m_RecvHead = m_RecvTail = 0;
+	m_SendHead = m_SendTail = 0;
+	m_RecvWaiting = 0;
+	m_Stop = 0;
+	m_Socket = Socket;
+	semaphore_init(&m_RecvSignal);
+
+	m_pThread = thread_init(ThreadFunc, this);
+	if(!m_pThread)
+	{
+		semaphore_destroy(&m_RecvSignal);
+		mem_free(m_pRecvQueue);
+		mem_free(m_pSendQueue);
+		m_pRecvQueue = 0;
+		m_pSendQueue = 0;
+		dbg_msg("network", "failed to start the network thread");
+		return false;
+	}
+
+	dbg_msg("network", "network thread started");
+	return true;
+}
+
+void CNetIOThread::Stop()
+{
+	if(!m_pThread)
+		return;
+
+	// the thread flushes the pending sends before it leaves
+	m_Stop = 1;
+	thread_wait(m_pThread);
+	m_pThread = 0;
+
+	if(m_NumDropped || m_NumSendOverflows)
+		dbg_msg("network", "network thread stopped, dropped=%d send_overflows=%d", m_NumDropped, m_NumSendOverflows);
+
+	semaphore_destroy(&m_RecvSignal);
+	mem_free(m_pRecvQueue);
+	mem_free(m_pSendQueue);
+	m_pRecvQueue = 0;
+	m_pSendQueue = 0;
+	m_Socket.type = 0;
+	m_Socket.ipv4sock = -1;
+	m_Socket.ipv6sock = -1;
+}
+
+bool CNetIOThread::Owns(NETSOCKET Socket) const
+{
+	return m_pThread && Socket.ipv4sock == m_Socket.ipv4sock && Socket.ipv6sock == m_Socket.ipv6sock;
+}
+
+void CNetIOThread::FlushSends()
+{
+	while(m_SendTail != m_SendHead)
+	{
+		sync_barrier();
+		CSendEntry *pEntry = &m_pSendQueue[m_SendTail];
+		net_udp_send(m_Socket, &pEntry->m_Addr, pEntry->m_aData, pEntry->m_Size);
+		sync_barrier();
+		m_SendTail = (m_SendTail+1)&(SEND_QUEUE_SIZE-1);
+	}
+}
+
+void CNetIOThread::ReceiveAll()
+{
+	unsigned char aBuffer[NET_MAX_PACKETSIZE];
+	bool Pushed = false;
+
+	// bound the burst so outgoing packets don't starve
+	for(int i = 0; i < RECV_QUEUE_SIZE/4; i++)
+	{
+		NETADDR Addr;
+		int Bytes = net_udp_recv(m_Socket, &Addr, aBuffer, NET_MAX_PACKETSIZE);
+		if(Bytes <= 0)
+			break;
+
+		int Next = (m_RecvHead+1)&(RECV_QUEUE_SIZE-1);
+		if(Next == m_RecvTail)
+		{
+			m_NumDropped++;
+			continue;
+		}
+
+		// unpack straight into the free slot, it only becomes visible once the head moves
+		CRecvEntry *pEntry = &m_pRecvQueue[m_RecvHead];
+		if(CNetBase::UnpackPacket(aBuffer, Bytes, &pEntry->m_Packet) != 0)
+			continue;
+
+		// under pressure, connectionless traffic (server info, tokens) goes first
+		if((pEntry->m_Packet.m_Flags&NET_PACKETFLAG_CONNLESS) && RecvQueued() >= RECV_QUEUE_SIZE*3/4)
+		{
+			m_NumDropped++;
+			continue;
+		}
+
+		pEntry->m_Addr = Addr;
+		sync_barrier();
+		m_RecvHead = Next;
+		Pushed = true;
+	}
+
+	if(Pushed)
+	{
+		sync_barrier();
+		if(m_RecvWaiting)
+		{
+			m_RecvWaiting = 0;
+			semaphore_signal(&m_RecvSignal);
+		}
+	}
+}
+
+void CNetIOThread::ThreadFunc(void *pUser)
+{
+	CNetIOThread *pThis = (CNetIOThread *)pUser;
+
+	while(!pThis->m_Stop)
+	{
+		pThis->FlushSends();
+		net_socket_read_wait(pThis->m_Socket, 1);
+		pThis->ReceiveAll();
+	}
+
+	pThis->FlushSends();
+}
+
+bool CNetIOThread::Recv(NETADDR *pAddr, CNetPacketConstruct *pPacket)
+{
+	if(m_RecvTail == m_RecvHead)
+		return false;
+
+	sync_barrier();
+	CRecvEntry *pEntry = &m_pRecvQueue[m_RecvTail];
+	*pAddr = pEntry->m_Addr;
+	mem_copy(pPacket, &pEntry->m_Packet, sizeof(*pPacket));
+	sync_barrier();
+	m_RecvTail = (m_RecvTail+1)&(RECV_QUEUE_SIZE-1);
+	return true;
+}
+
+bool CNetIOThread::Send(const NETADDR *pAddr, const void *pData, int Size)
+{
+	int Next = (m_SendHead+1)&(SEND_QUEUE_SIZE-1);
+	if(Next == m_SendTail || Size > NET_MAX_PACKETSIZE)
+	{
+		m_NumSendOverflows++;
+		return false;
+	}
+
+	CSendEntry *pEntry = &m_pSendQueue[m_SendHead];
+	pEntry->m_Addr = *pAddr;
+	pEntry->m_Size = Size;
+	mem_copy(pEntry->m_aData, pData, Size);
+	sync_barrier();
+	m_SendHead = Next;
+	return true;
+}
+
+void CNetIOThread::WaitRecv(int Ms)
+{
+	m_RecvWaiting = 1;
+	sync_barrier();
+	if(m_RecvTail == m_RecvHead)
+		semaphore_wait_timeout(&m_RecvSignal, Ms);
+	m_RecvWaiting = 0;
+}
@@ -27,11 +27,15 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	mem_zero(this, sizeof(*this));
 
 	// open socket
-	m_Socket = net_udp_create(BindAddr, 0);
+	if(Flags&NETCREATE_FLAG_REUSEPORT)
+		m_Socket = net_udp_create_shared(BindAddr);
+	else
+		m_Socket = net_udp_create(BindAddr, 0);
 	if(!m_Socket.type)
 		return false;
 
 	m_pNetBan = pNetBan;
+	m_pIOThread = 0;
 
 	// clamp clients
 	m_MaxClients = MaxClients;
@@ -543,12 +547,25 @@ int CNetServer::Recv(CNetChunk *pChunk)
 		if(m_RecvUnpacker.FetchChunk(pChunk))
 			return 1;
 
-		// TODO: empty the recvinfo
-		int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE);
+		int Unpacked;
+		if(m_pIOThread)
+		{
+			// already received, validated and unpacked by the network thread
+			if(!m_pIOThread->Recv(&Addr, &m_RecvUnpacker.m_Data))
+				break;
+			Unpacked = 0;
+		}
+		else
+		{
+			// TODO: empty the recvinfo
+			int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE);
+
+			// no more packets for now
+			if(Bytes <= 0)
+				break;
 
-		// no more packets for now
-		if(Bytes <= 0)
-			break;
+			Unpacked = CNetBase::UnpackPacket(m_RecvUnpacker.m_aBuffer, Bytes, &m_RecvUnpacker.m_Data);
+		}
 				
 		// check if we just should drop the packet
 		char aBuf[128];
@@ -559,7 +576,7 @@ int CNetServer::Recv(CNetChunk *pChunk)
 			continue;
 		} */
 				
-		if(CNetBase::UnpackPacket(m_RecvUnpacker.m_aBuffer, Bytes, &m_RecvUnpacker.m_Data) == 0)
+		if(Unpacked == 0)
 		{
 			if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
 			{
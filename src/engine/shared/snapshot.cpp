@@ -378,121 +378,182 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 // CSnapshotStorage
 
+CSnapshotStorage::CSnapshotStorage()
+{
+	m_pData = 0;
+	m_DataCapacity = 0;
+	Init();
+}
+
+CSnapshotStorage::~CSnapshotStorage()
+{
+	mem_free(m_pData);
+}
+
 void CSnapshotStorage::Init()
 {
-	m_pFirst = 0;
-	m_pLast = 0;
+	for(int i = 0; i < HISTORY_SIZE; i++)
+		m_aHolders[i].m_Tick = -1;
+	m_OrderStart = 0;
+	m_NumHolders = 0;
+	m_DataHead = 0;
+	m_DataTail = 0;
 }
 
 void CSnapshotStorage::PurgeAll()
 {
-	CHolder *pHolder = m_pFirst;
-	CHolder *pNext;
+	// the arena is kept for the next client
+	Init();
+}
 
-	while(pHolder)
-	{
-		pNext = pHolder->m_pNext;
-		mem_free(pHolder);
-		pHolder = pNext;
-	}
+void CSnapshotStorage::PurgeFirst()
+{
+	m_aHolders[m_aOrder[m_OrderStart]&(HISTORY_SIZE-1)].m_Tick = -1;
+	m_OrderStart = (m_OrderStart+1)&(HISTORY_SIZE-1);
+	m_NumHolders--;
 
-	// no more snapshots in storage
-	m_pFirst = 0;
-	m_pLast = 0;
+	// the oldest remaining snapshot marks the end of the used arena
+	if(m_NumHolders)
+		m_DataTail = m_aHolders[m_aOrder[m_OrderStart]&(HISTORY_SIZE-1)].m_Offset;
+	else
+		m_DataHead = m_DataTail = 0;
 }
 
 void CSnapshotStorage::PurgeUntil(int Tick)
 {
-	CHolder *pHolder = m_pFirst;
-	CHolder *pNext;
+	while(m_NumHolders && m_aOrder[m_OrderStart] < Tick)
+		PurgeFirst();
+}
 
-	while(pHolder)
+void CSnapshotStorage::Grow(int Size)
+{
+	int Used = 0;
+	for(int i = 0; i < m_NumHolders; i++)
+		Used += m_aHolders[m_aOrder[(m_OrderStart+i)&(HISTORY_SIZE-1)]&(HISTORY_SIZE-1)].m_Size;
+
+	int Capacity = m_DataCapacity ? m_DataCapacity*2 : CSnapshot::MAX_SIZE*2;
+	while(Capacity < Used+Size*2)
+		Capacity *= 2;
+
+	// copy the stored snapshots over in order, unwrapping the ring
+	char *pData = (char *)mem_alloc(Capacity, 1);
+	int Head = 0;
+	for(int i = 0; i < m_NumHolders; i++)
 	{
-		pNext = pHolder->m_pNext;
-		if(pHolder->m_Tick >= Tick)
-			return; // no more to remove
-		mem_free(pHolder);
-
-		// did we come to the end of the list?
-		if (!pNext)
-			break;
+		CHolder *pHolder = &m_aHolders[m_aOrder[(m_OrderStart+i)&(HISTORY_SIZE-1)]&(HISTORY_SIZE-1)];
+		mem_copy(pData+Head, m_pData+pHolder->m_Offset, pHolder->m_Size);
+		pHolder->m_Offset = Head;
+		Head += pHolder->m_Size;
+	}
 
-		m_pFirst = pNext;
-		pNext->m_pPrev = 0x0;
+	mem_free(m_pData);
+	m_pData = pData;
+	m_DataCapacity = Capacity;
+	m_DataTail = 0;
+	m_DataHead = Head;
+}
 
-		pHolder = pNext;
+int CSnapshotStorage::Allocate(int Size)
+{
+	// the used part of the arena runs from tail to head, possibly wrapping around.
+	// head never catches up with tail so that an empty and a full arena can't be mixed up
+	if(m_NumHolders == 0 || m_DataHead > m_DataTail)
+	{
+		if(m_DataCapacity - m_DataHead >= Size)
+		{
+			m_DataHead += Size;
+			return m_DataHead - Size;
+		}
+		if(m_NumHolders && Size < m_DataTail)
+		{
+			m_DataHead = Size;
+			return 0;
+		}
+	}
+	else if(m_DataTail - m_DataHead > Size)
+	{
+		m_DataHead += Size;
+		return m_DataHead - Size;
 	}
 
-	// no more snapshots in storage
-	m_pFirst = 0;
-	m_pLast = 0;
+	Grow(Size);
+	m_DataHead += Size;
+	return m_DataHead - Size;
 }
 
 void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt)
 {
-	// allocate memory for holder + snapshot_data
-	int TotalSize = sizeof(CHolder)+DataSize;
+	// ticks have to be added in order and stay within the history window
+	if(m_NumHolders && Tick <= m_aOrder[(m_OrderStart+m_NumHolders-1)&(HISTORY_SIZE-1)])
+		PurgeAll();
+	PurgeUntil(Tick-HISTORY_SIZE+1);
 
+	int Size = (DataSize+7)&~7;
 	if(CreateAlt)
-		TotalSize += DataSize;
-
-	CHolder *pHolder = (CHolder *)mem_alloc(TotalSize, 1);
+		Size *= 2;
 
-	// set data
+	CHolder *pHolder = &m_aHolders[Tick&(HISTORY_SIZE-1)];
+	pHolder->m_Offset = Allocate(Size);
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
 	pHolder->m_SnapSize = DataSize;
-	pHolder->m_pSnap = (CSnapshot*)(pHolder+1);
-	mem_copy(pHolder->m_pSnap, pData, DataSize);
+	pHolder->m_Size = Size;
+	pHolder->m_HasAlt = CreateAlt != 0;
 
+	mem_copy(m_pData+pHolder->m_Offset, pData, DataSize);
 	if(CreateAlt) // create alternative if wanted
-	{
-		pHolder->m_pAltSnap = (CSnapshot*)(((char *)pHolder->m_pSnap) + DataSize);
-		mem_copy(pHolder->m_pAltSnap, pData, DataSize);
-	}
-	else
-		pHolder->m_pAltSnap = 0;
+		mem_copy(m_pData+pHolder->m_Offset+Size/2, pData, DataSize);
 
-
-	// link
-	pHolder->m_pNext = 0;
-	pHolder->m_pPrev = m_pLast;
-	if(m_pLast)
-		m_pLast->m_pNext = pHolder;
-	else
-		m_pFirst = pHolder;
-	m_pLast = pHolder;
+	m_aOrder[(m_OrderStart+m_NumHolders)&(HISTORY_SIZE-1)] = Tick;
+	m_NumHolders++;
 }
 
 int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
 {
-	CHolder *pHolder = m_pFirst;
-
-	while(pHolder)
-	{
-		if(pHolder->m_Tick == Tick)
-		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
-		}
+	if(Tick < 0)
+		return -1;
 
-		pHolder = pHolder->m_pNext;
-	}
+	CHolder *pHolder = &m_aHolders[Tick&(HISTORY_SIZE-1)];
+	if(pHolder->m_Tick != Tick)
+		return -1;
 
-	return -1;
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = (CSnapshot *)(m_pData+pHolder->m_Offset);
+	if(ppAltData)
+		*ppAltData = pHolder->m_HasAlt ? (CSnapshot *)(m_pData+pHolder->m_Offset+pHolder->m_Size/2) : 0;
+	return pHolder->m_SnapSize;
 }
 
 // CSnapshotBuilder
 
+CSnapshotBuilder::CSnapshotBuilder()
+{
+	mem_zero(m_aHashGeneration, sizeof(m_aHashGeneration));
+	m_Generation = 0;
+	Init();
+}
+
 void CSnapshotBuilder::Init()
 {
 	m_DataSize = 0;
 	m_NumItems = 0;
+
+	if(++m_Generation == 0)
+	{
+		mem_zero(m_aHashGeneration, sizeof(m_aHashGeneration));
+		m_Generation = 1;
+	}
+}
+
+// returns the slot holding Key or the free slot it would go to
+int CSnapshotBuilder::FindSlot(int Key) const
+{
+	unsigned Slot = ((unsigned)Key*2654435761u)&(HASH_SIZE-1);
+	while(m_aHashGeneration[Slot] == m_Generation && m_aHashKeys[Slot] != Key)
+		Slot = (Slot+1)&(HASH_SIZE-1);
+	return Slot;
 }
 
 CSnapshotItem *CSnapshotBuilder::GetItem(int Index)
@@ -502,13 +563,10 @@ CSnapshotItem *CSnapshotBuilder::GetItem(int Index)
 
 int *CSnapshotBuilder::GetItemData(int Key)
 {
-	int i;
-	for(i = 0; i < m_NumItems; i++)
-	{
-		if(GetItem(i)->Key() == Key)
-			return (int *)GetItem(i)->Data();
-	}
-	return 0;
+	int Slot = FindSlot(Key);
+	if(m_aHashGeneration[Slot] != m_Generation)
+		return 0;
+	return (int *)GetItem(m_aHashItems[Slot])->Data();
 }
 
 int CSnapshotBuilder::Finish(void *pSpnapData)
@@ -533,10 +591,22 @@ void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
 		return 0;
 	}
 
+	// keys have to be unique, the deltas and the client rely on it
+	int Key = (Type<<16)|ID;
+	int Slot = FindSlot(Key);
+	if(m_aHashGeneration[Slot] == m_Generation)
+	{
+		dbg_msg("snapshot", "duplicate item type=%d id=%d", Type, ID);
+		return 0;
+	}
+	m_aHashKeys[Slot] = Key;
+	m_aHashItems[Slot] = m_NumItems;
+	m_aHashGeneration[Slot] = m_Generation;
+
 	CSnapshotItem *pObj = (CSnapshotItem *)(m_aData + m_DataSize);
 
 	mem_zero(pObj, sizeof(CSnapshotItem) + Size);
-	pObj->m_TypeAndID = (Type<<16)|ID;
+	pObj->m_TypeAndID = Key;
 	m_aOffsets[m_NumItems] = m_DataSize;
 	m_DataSize += sizeof(CSnapshotItem) + Size;
 	m_NumItems++;
@@ -86,36 +86,60 @@ public:
 class CSnapshotStorage
 {
 public:
+	enum
+	{
+		// must be a power of two and cover the purge window (3 seconds)
+		HISTORY_SIZE=256,
+	};
+
 	class CHolder
 	{
 	public:
-		CHolder *m_pPrev;
-		CHolder *m_pNext;
-
 		int64 m_Tagtime;
 		int m_Tick;
 
 		int m_SnapSize;
-		CSnapshot *m_pSnap;
-		CSnapshot *m_pAltSnap;
+		int m_Offset;
+		int m_Size;
+		bool m_HasAlt;
 	};
 
+	// slot is tick modulo HISTORY_SIZE, m_Tick is -1 for free slots
+	CHolder m_aHolders[HISTORY_SIZE];
+
+	// stored ticks in insertion order
+	int m_aOrder[HISTORY_SIZE];
+	int m_OrderStart;
+	int m_NumHolders;
 
-	CHolder *m_pFirst;
-	CHolder *m_pLast;
+	// ring arena holding the snapshot data, only grows
+	char *m_pData;
+	int m_DataCapacity;
+	int m_DataHead;
+	int m_DataTail;
+
+	CSnapshotStorage();
+	~CSnapshotStorage();
 
 	void Init();
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt);
+	// returned pointers are valid until the next Add
 	int Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
+
+private:
+	void PurgeFirst();
+	int Allocate(int Size);
+	void Grow(int Size);
 };
 
 class CSnapshotBuilder
 {
 	enum
 	{
-		MAX_ITEMS = 1024
+		MAX_ITEMS = 1024,
+		HASH_SIZE = MAX_ITEMS*2,
 	};
 
 	char m_aData[CSnapshot::MAX_SIZE];
@@ -124,7 +148,17 @@ class CSnapshotBuilder
 	int m_aOffsets[MAX_ITEMS];
 	int m_NumItems;
 
+	// open addressed key -> item index table. a slot only counts if its
+	// generation matches, so Init doesn't have to clear it
+	int m_aHashKeys[HASH_SIZE];
+	short m_aHashItems[HASH_SIZE];
+	unsigned m_aHashGeneration[HASH_SIZE];
+	unsigned m_Generation;
+
+	int FindSlot(int Key) const;
+
 public:
+	CSnapshotBuilder();
 	void Init();
 
 	void *NewItem(int Type, int ID, int Size);
@@ -21,6 +21,24 @@ CCollision::CCollision()
 	m_Height = 0;
 	m_pLayers = 0;
 	m_AnimationTime = 0.0;
+	m_pFlags = 0;
+	m_pSolid = 0;
+	m_SolidPitch = 0;
+}
+
+CCollision::~CCollision()
+{
+	if (m_pFlags)
+		mem_free(m_pFlags);
+	if (m_pSolid)
+		mem_free(m_pSolid);
+	for (int i = 0; i < m_aZoneGrids.size(); i++)
+	{
+		if (m_aZoneGrids[i].m_pValues)
+			mem_free(m_aZoneGrids[i].m_pValues);
+		if (m_aZoneGrids[i].m_pMixed)
+			mem_free(m_aZoneGrids[i].m_pMixed);
+	}
 }
 
 int CCollision::GetZoneHandle(const char *pName)
@@ -31,6 +49,10 @@ int CCollision::GetZoneHandle(const char *pName)
 	int Handle = m_Zones.size();
 	m_Zones.add(array<int>());
 
+	CZoneGrid Grid;
+	mem_zero(&Grid, sizeof(Grid));
+	m_aZoneGrids.add(Grid);
+
 	array<int> &LayerList = m_Zones[Handle];
 
 	char aLayerName[12];
@@ -50,7 +72,14 @@ int CCollision::GetZoneHandle(const char *pName)
 			CMapItemLayerQuads *pQLayer = (CMapItemLayerQuads *)pLayer;
 			IntsToStr(pQLayer->m_aName, sizeof(aLayerName) / sizeof(int), aLayerName);
 			if (str_comp(pName, aLayerName) == 0)
+			{
 				LayerList.add(l);
+
+				const CQuad *pQuads = (const CQuad *)m_pLayers->Map()->GetDataSwapped(pQLayer->m_Data);
+				for (int q = 0; q < pQLayer->m_NumQuads; q++)
+					if (pQuads[q].m_PosEnv >= 0)
+						m_aZoneGrids[Handle].m_Animated = true;
+			}
 		}
 	}
 
@@ -116,14 +145,28 @@ static void Rotate(vec2 *pCenter, vec2 *pPoint, float Rotation)
 	pPoint->y = (x * sinf(Rotation) + y * cosf(Rotation) + pCenter->y);
 }
 
-int CCollision::GetZoneValueAt(int ZoneHandle, float x, float y)
+static void GetQuadPoints(const CQuad *pQuad, double Time, CLayers *pLayers, vec2 *pPoints)
 {
-	if (!m_pLayers->ZoneGroup())
-		return 0;
+	vec2 Position(0.0f, 0.0f);
+	float Angle = 0.0f;
+	if (pQuad->m_PosEnv >= 0)
+	{
+		GetAnimationTransform(Time, pQuad->m_PosEnv, pLayers, Position, Angle);
+	}
 
-	if (ZoneHandle < 0 || ZoneHandle >= m_Zones.size())
-		return 0;
+	for (int i = 0; i < 4; i++)
+		pPoints[i] = Position + vec2(fx2f(pQuad->m_aPoints[i].x), fx2f(pQuad->m_aPoints[i].y));
 
+	if (Angle != 0)
+	{
+		vec2 center(fx2f(pQuad->m_aPoints[4].x), fx2f(pQuad->m_aPoints[4].y));
+		for (int i = 0; i < 4; i++)
+			Rotate(&center, &pPoints[i], Angle);
+	}
+}
+
+int CCollision::GetZoneValueAtExact(int ZoneHandle, float x, float y)
+{
 	int Index = 0;
 
 	for (int i = 0; i < m_Zones[ZoneHandle].size(); i++)
@@ -152,36 +195,143 @@ int CCollision::GetZoneValueAt(int ZoneHandle, float x, float y)
 
 			for (int q = 0; q < pQLayer->m_NumQuads; q++)
 			{
-				vec2 Position(0.0f, 0.0f);
-				float Angle = 0.0f;
-				if (pQuads[q].m_PosEnv >= 0)
+				vec2 aPoints[4];
+				GetQuadPoints(&pQuads[q], m_AnimationTime, m_pLayers, aPoints);
+
+				if (InsideQuad(aPoints[0], aPoints[1], aPoints[2], aPoints[3], vec2(x, y)))
 				{
-					GetAnimationTransform(m_AnimationTime, pQuads[q].m_PosEnv, m_pLayers, Position, Angle);
+					Index = pQuads[q].m_ColorEnvOffset;
 				}
+			}
+		}
+	}
+
+	return Index;
+}
+
+// Rasterizes the zone into one cell per game tile. A cell gets a value
+// when every point in it gets the same answer from GetZoneValueAtExact,
+// cells a quad edge passes through are marked mixed and resolved exactly.
+void CCollision::BuildZoneGrid(int ZoneHandle)
+{
+	CZoneGrid *pGrid = &m_aZoneGrids[ZoneHandle];
+	int NumCells = m_Width * m_Height;
+	if (!pGrid->m_pValues)
+	{
+		pGrid->m_pValues = (int *)mem_alloc(NumCells * sizeof(int), sizeof(int));
+		pGrid->m_pMixed = (unsigned char *)mem_alloc(NumCells, 1);
+	}
+	mem_zero(pGrid->m_pValues, NumCells * sizeof(int));
+	mem_zero(pGrid->m_pMixed, NumCells);
+	pGrid->m_Time = m_AnimationTime;
+	pGrid->m_Valid = true;
 
-				vec2 p0 = Position + vec2(fx2f(pQuads[q].m_aPoints[0].x), fx2f(pQuads[q].m_aPoints[0].y));
-				vec2 p1 = Position + vec2(fx2f(pQuads[q].m_aPoints[1].x), fx2f(pQuads[q].m_aPoints[1].y));
-				vec2 p2 = Position + vec2(fx2f(pQuads[q].m_aPoints[2].x), fx2f(pQuads[q].m_aPoints[2].y));
-				vec2 p3 = Position + vec2(fx2f(pQuads[q].m_aPoints[3].x), fx2f(pQuads[q].m_aPoints[3].y));
+	for (int i = 0; i < m_Zones[ZoneHandle].size(); i++)
+	{
+		int l = m_Zones[ZoneHandle][i];
 
-				if (Angle != 0)
+		CMapItemLayer *pLayer = m_pLayers->GetLayer(m_pLayers->ZoneGroup()->m_StartLayer + l);
+		if (pLayer->m_Type == LAYERTYPE_TILES)
+		{
+			CMapItemLayerTilemap *pTLayer = (CMapItemLayerTilemap *)pLayer;
+
+			CTile *pTiles = (CTile *)m_pLayers->Map()->GetData(pTLayer->m_Data);
+
+			for (int y = 0; y < m_Height; y++)
+				for (int x = 0; x < m_Width; x++)
 				{
-					vec2 center(fx2f(pQuads[q].m_aPoints[4].x), fx2f(pQuads[q].m_aPoints[4].y));
-					Rotate(&center, &p0, Angle);
-					Rotate(&center, &p1, Angle);
-					Rotate(&center, &p2, Angle);
-					Rotate(&center, &p3, Angle);
+					int Nx = clamp(x, 0, pTLayer->m_Width - 1);
+					int Ny = clamp(y, 0, pTLayer->m_Height - 1);
+
+					int TileIndex = (pTiles[Ny * pTLayer->m_Width + Nx].m_Index > 128 ? 0 : pTiles[Ny * pTLayer->m_Width + Nx].m_Index);
+					if (TileIndex > 0)
+					{
+						pGrid->m_pValues[y * m_Width + x] = TileIndex;
+						pGrid->m_pMixed[y * m_Width + x] = 0;
+					}
 				}
+		}
+		else if (pLayer->m_Type == LAYERTYPE_QUADS)
+		{
+			CMapItemLayerQuads *pQLayer = (CMapItemLayerQuads *)pLayer;
 
-				if (InsideQuad(p0, p1, p2, p3, vec2(x, y)))
+			const CQuad *pQuads = (const CQuad *)m_pLayers->Map()->GetDataSwapped(pQLayer->m_Data);
+
+			for (int q = 0; q < pQLayer->m_NumQuads; q++)
+			{
+				vec2 aPoints[4];
+				GetQuadPoints(&pQuads[q], m_AnimationTime, m_pLayers, aPoints);
+
+				vec2 Min = aPoints[0], Max = aPoints[0];
+				for (int k = 1; k < 4; k++)
 				{
-					Index = pQuads[q].m_ColorEnvOffset;
+					Min = vec2(min(Min.x, aPoints[k].x), min(Min.y, aPoints[k].y));
+					Max = vec2(max(Max.x, aPoints[k].x), max(Max.y, aPoints[k].y));
 				}
+
+				// a cell holds the points that round into its tile, padded
+				// by a pixel so float noise at the border can't matter
+				int FromX = max((int)floorf((Min.x - 32.5f) / 32.0f), 0);
+				int FromY = max((int)floorf((Min.y - 32.5f) / 32.0f), 0);
+				int ToX = min((int)ceilf((Max.x + 1.5f) / 32.0f), m_Width - 1);
+				int ToY = min((int)ceilf((Max.y + 1.5f) / 32.0f), m_Height - 1);
+
+				for (int y = FromY; y <= ToY; y++)
+					for (int x = FromX; x <= ToX; x++)
+					{
+						vec2 CellMin(x * 32.0f - 1.5f, y * 32.0f - 1.5f);
+						vec2 CellMax(x * 32.0f + 32.5f, y * 32.0f + 32.5f);
+						if (CellMax.x < Min.x || CellMin.x > Max.x || CellMax.y < Min.y || CellMin.y > Max.y)
+							continue;
+
+						vec2 aCorners[4] = {CellMin, vec2(CellMax.x, CellMin.y), vec2(CellMin.x, CellMax.y), CellMax};
+
+						// InsideQuad picks one of two triangles by the side of the
+						// q1-q2 diagonal, a cell fully inside is one that sits on
+						// one side and has all its corners in that triangle
+						bool Inside = true;
+						for (int k = 0; k < 4 && Inside; k++)
+						{
+							if (SameSide(aPoints[1], aPoints[2], aCorners[k], aPoints[0]) != SameSide(aPoints[1], aPoints[2], aCorners[0], aPoints[0]))
+								Inside = false;
+							else if (!InsideQuad(aPoints[0], aPoints[1], aPoints[2], aPoints[3], aCorners[k]))
+								Inside = false;
+						}
+
+						if (Inside)
+						{
+							pGrid->m_pValues[y * m_Width + x] = pQuads[q].m_ColorEnvOffset;
+							pGrid->m_pMixed[y * m_Width + x] = 0;
+						}
+						else
+							pGrid->m_pMixed[y * m_Width + x] = 1;
+					}
 			}
 		}
 	}
+}
 
-	return Index;
+int CCollision::GetZoneValueAt(int ZoneHandle, float x, float y)
+{
+	if (!m_pLayers->ZoneGroup())
+		return 0;
+
+	if (ZoneHandle < 0 || ZoneHandle >= m_Zones.size())
+		return 0;
+
+	int Rx = round_to_int(x);
+	int Ry = round_to_int(y);
+	if (Rx < 0 || Ry < 0 || Rx >= m_Width * 32 || Ry >= m_Height * 32)
+		return GetZoneValueAtExact(ZoneHandle, x, y);
+
+	CZoneGrid *pGrid = &m_aZoneGrids[ZoneHandle];
+	if (!pGrid->m_Valid || (pGrid->m_Animated && pGrid->m_Time != m_AnimationTime))
+		BuildZoneGrid(ZoneHandle);
+
+	int Cell = (Ry / 32) * m_Width + Rx / 32;
+	if (pGrid->m_pMixed[Cell])
+		return GetZoneValueAtExact(ZoneHandle, x, y);
+	return pGrid->m_pValues[Cell];
 }
 
 void CCollision::Init(class CLayers *pLayers)
@@ -213,6 +363,31 @@ void CCollision::Init(class CLayers *pLayers)
 			m_pTiles[i].m_Index = 0;
 		}
 	}
+
+	if (m_pFlags)
+		mem_free(m_pFlags);
+	if (m_pSolid)
+		mem_free(m_pSolid);
+	m_SolidPitch = (m_Width + 31) / 32;
+	m_pFlags = (unsigned char *)mem_alloc(m_Width * m_Height, 1);
+	m_pSolid = (unsigned *)mem_alloc(m_SolidPitch * m_Height * sizeof(unsigned), sizeof(unsigned));
+	mem_zero(m_pSolid, m_SolidPitch * m_Height * sizeof(unsigned));
+
+	for (int i = 0; i < m_Width * m_Height; i++)
+		UpdateFlags(i);
+}
+
+void CCollision::UpdateFlags(int Index)
+{
+	int Flags = m_pTiles[Index].m_Index > 128 ? 0 : m_pTiles[Index].m_Index;
+	m_pFlags[Index] = Flags;
+
+	unsigned *pWord = &m_pSolid[(Index / m_Width) * m_SolidPitch + (Index % m_Width) / 32];
+	unsigned Bit = 1u << ((Index % m_Width) & 31);
+	if (Flags & COLFLAG_SOLID)
+		*pWord |= Bit;
+	else
+		*pWord &= ~Bit;
 }
 
 int CCollision::GetTile(int x, int y)
@@ -220,12 +395,48 @@ int CCollision::GetTile(int x, int y)
 	int Nx = clamp(x / 32, 0, m_Width - 1);
 	int Ny = clamp(y / 32, 0, m_Height - 1);
 
-	return m_pTiles[Ny * m_Width + Nx].m_Index > 128 ? 0 : m_pTiles[Ny * m_Width + Nx].m_Index;
+	return m_pFlags[Ny * m_Width + Nx];
 }
 
 bool CCollision::IsTileSolid(int x, int y)
 {
-	return GetTile(x, y) & COLFLAG_SOLID;
+	int Nx = clamp(x / 32, 0, m_Width - 1);
+	int Ny = clamp(y / 32, 0, m_Height - 1);
+
+	return (m_pSolid[Ny * m_SolidPitch + Nx / 32] >> (Nx & 31)) & 1;
+}
+
+bool CCollision::IsRowSolid(int y, int FromX, int ToX)
+{
+	FromX = max(FromX, 0);
+	ToX = min(ToX, m_Width - 1);
+	if (y < 0 || y >= m_Height || FromX > ToX)
+		return false;
+
+	// a word at a time, masking the partial words at both ends
+	const unsigned *pRow = &m_pSolid[y * m_SolidPitch];
+	int FromWord = FromX / 32;
+	int ToWord = ToX / 32;
+	unsigned FromMask = ~0u << (FromX & 31);
+	unsigned ToMask = ~0u >> (31 - (ToX & 31));
+
+	if (FromWord == ToWord)
+		return (pRow[FromWord] & FromMask & ToMask) != 0;
+
+	if (pRow[FromWord] & FromMask)
+		return true;
+	for (int w = FromWord + 1; w < ToWord; w++)
+		if (pRow[w])
+			return true;
+	return (pRow[ToWord] & ToMask) != 0;
+}
+
+bool CCollision::IsAreaSolid(int FromX, int FromY, int ToX, int ToY)
+{
+	for (int y = max(FromY, 0); y <= min(ToY, m_Height - 1); y++)
+		if (IsRowSolid(y, FromX, ToX))
+			return true;
+	return false;
 }
 
 // TODO: rewrite this smarter!
@@ -309,6 +520,86 @@ bool CCollision::TestBox(vec2 Pos, vec2 Size)
 	return false;
 }
 
+// Returns how many of the next Steps steps the box can take before one of
+// its corners could reach a solid tile, from the swept box's time of impact
+// against the solid tiles around it. Errs on the short side.
+int CCollision::FreeBoxSteps(vec2 Pos, vec2 Step, int Steps, vec2 Size)
+{
+	Size *= 0.5f;
+
+	// shifted by half a pixel round_to_int(v)/32 becomes floor(v/32), same
+	// float expressions as in TestBox so a resting axis compares exactly
+	float aMin[2] = {(Pos.x - Size.x) + 0.5f, (Pos.y - Size.y) + 0.5f};
+	float aMax[2] = {(Pos.x + Size.x) + 0.5f, (Pos.y + Size.y) + 0.5f};
+	float aMove[2] = {Step.x * Steps, Step.y * Steps};
+	int aNumTiles[2] = {m_Width, m_Height};
+
+	// accumulating the steps drifts from Pos+Step*i on a moving axis
+	float Margin = 1.0f + Steps * (absolute(Pos.x) + absolute(Pos.y) + absolute(aMove[0]) + absolute(aMove[1]) + Size.x + Size.y) * 2e-7f;
+
+	int aFrom[2], aTo[2];
+	for (int a = 0; a < 2; a++)
+	{
+		float Pad = aMove[a] != 0.0f ? Margin : 0.0f;
+		aFrom[a] = clamp((int)floorf((min(aMin[a], aMin[a] + aMove[a]) - Pad) / 32.0f), 0, aNumTiles[a] - 1);
+		aTo[a] = clamp((int)floorf((max(aMax[a], aMax[a] + aMove[a]) + Pad) / 32.0f), 0, aNumTiles[a] - 1);
+	}
+
+	// nothing solid in the way
+	if (!IsAreaSolid(aFrom[0], aFrom[1], aTo[0], aTo[1]))
+		return Steps;
+
+	// too far to be worth it
+	if ((aTo[0] - aFrom[0] + 1) * (aTo[1] - aFrom[1] + 1) > 256)
+		return 0;
+
+	float Impact = 2.0f;
+	for (int y = aFrom[1]; y <= aTo[1]; y++)
+	{
+		if (!IsRowSolid(y, aFrom[0], aTo[0]))
+			continue;
+
+		for (int x = aFrom[0]; x <= aTo[0]; x++)
+		{
+			if (!(m_pFlags[y * m_Width + x] & COLFLAG_SOLID))
+				continue;
+
+			int aTile[2] = {x, y};
+			float Enter = 0.0f, Leave = 1.0f;
+			for (int a = 0; a < 2 && Enter <= Leave; a++)
+			{
+				// border tiles extend beyond the map
+				float Pad = aMove[a] != 0.0f ? Margin : 0.0f;
+				float Lo = aTile[a] == 0 ? -1e9f : aTile[a] * 32.0f - Pad;
+				float Hi = aTile[a] == aNumTiles[a] - 1 ? 1e9f : aTile[a] * 32.0f + 32.0f + Pad;
+
+				if (aMove[a] == 0.0f)
+				{
+					if (aMax[a] < Lo || aMin[a] >= Hi)
+						Leave = -1.0f;
+				}
+				else if (aMove[a] > 0.0f)
+				{
+					Enter = max(Enter, (Lo - aMax[a]) / aMove[a]);
+					Leave = min(Leave, (Hi - aMin[a]) / aMove[a]);
+				}
+				else
+				{
+					Enter = max(Enter, (Hi - aMin[a]) / aMove[a]);
+					Leave = min(Leave, (Lo - aMax[a]) / aMove[a]);
+				}
+			}
+
+			if (Enter <= Leave && Enter < Impact)
+				Impact = Enter;
+		}
+	}
+
+	if (Impact > 1.0f)
+		return Steps;
+	return clamp((int)ceilf(Impact * Steps) - 1, 0, Steps);
+}
+
 void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity)
 {
 	// do the move
@@ -320,20 +611,34 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elas
 
 	if (Distance > 0.00001f)
 	{
-		// vec2 old_pos = pos;
+		// the move still goes in Max+1 equal steps so the result matches
+		// the client's prediction, but only the steps close to a solid tile
+		// are tested one by one
 		float Fraction = 1.0f / (float)(Max + 1);
-		for (int i = 0; i <= Max; i++)
+		int Left = Max + 1;
+		int Exact = 0;
+		while (Left > 0)
 		{
-			// float amount = i/(float)max;
-			// if(max == 0)
-			// amount = 0;
+			if (Exact == 0)
+			{
+				for (int Free = FreeBoxSteps(Pos, Vel * Fraction, Left, Size); Free > 0; Free--, Left--)
+					Pos = Pos + Vel * Fraction;
+				if (Left == 0)
+					break;
+				Exact = 8;
+			}
 
 			vec2 NewPos = Pos + Vel * Fraction; // TODO: this row is not nice
+			Left--;
+			Exact--;
 
 			if (TestBox(vec2(NewPos.x, NewPos.y), Size))
 			{
 				int Hits = 0;
 
+				// the velocity changes, look ahead again
+				Exact = 0;
+
 				if (TestBox(vec2(Pos.x, NewPos.y), Size))
 				{
 					NewPos.y = Pos.y;
@@ -386,6 +691,10 @@ bool CCollision::ModifTile(ivec2 pos, int group, int layer, int tile, int flags,
 		pTiles[tpos].m_Flags = flags;
 		pTiles[tpos].m_Index = tile;
 		pTiles[tpos].m_Reserved = reserved;
+
+		// the zone layers might have changed
+		for (int i = 0; i < m_aZoneGrids.size(); i++)
+			m_aZoneGrids[i].m_Valid = false;
 	}
 	else
 	{
@@ -420,6 +729,8 @@ bool CCollision::ModifTile(ivec2 pos, int group, int layer, int tile, int flags,
 			if (tile <= 128)
 				m_pTiles[tpos].m_Index = 0;
 		}
+
+		UpdateFlags(tpos);
 	}
 
 	return true;
@@ -12,12 +12,35 @@ class CCollision
 	class CTile *m_pTiles;
 	int m_Width;
 	int m_Height;
+
+	// collision flags of the game layer, one byte per tile, and the solid
+	// tiles as a bitmap with m_SolidPitch words per row
+	unsigned char *m_pFlags;
+	unsigned *m_pSolid;
+	int m_SolidPitch;
+
+	void UpdateFlags(int Index);
 	class CLayers *m_pLayers;
 
 	double m_AnimationTime;
 
 	array< array<int> > m_Zones;
 
+	// zones rasterized per game tile, rebuilt when the animation time
+	// moves if the zone has animated quads
+	struct CZoneGrid
+	{
+		int *m_pValues;
+		unsigned char *m_pMixed;
+		double m_Time;
+		bool m_Animated;
+		bool m_Valid;
+	};
+	array<CZoneGrid> m_aZoneGrids;
+
+	void BuildZoneGrid(int ZoneHandle);
+	int GetZoneValueAtExact(int ZoneHandle, float x, float y);
+
 	int m_WaypointCount;
 	int m_ConnectionCount;
 	
@@ -61,6 +84,7 @@ public:
 	int ConnectionCount() { return m_ConnectionCount; }
 
 	CCollision();
+	~CCollision();
 
 	void SetWaypointCenter(vec2 Position);
 	void AddWeight(vec2 Pos, int Weight);
@@ -94,6 +118,10 @@ public:
 	void MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces);
 	void MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity);
 	bool TestBox(vec2 Pos, vec2 Size);
+	// tile coordinates, inclusive
+	bool IsRowSolid(int y, int FromX, int ToX);
+	bool IsAreaSolid(int FromX, int FromY, int ToX, int ToY);
+	int FreeBoxSteps(vec2 Pos, vec2 Step, int Steps, vec2 Size);
 
 	void SetTime(double Time) { m_AnimationTime = Time; }
 
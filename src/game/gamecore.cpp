@@ -55,6 +55,67 @@ float VelocityRamp(float Value, float Start, float Range, float Curvature)
 	return 1.0f/powf(Curvature, (Value-Start)/Range);
 }
 
+int CWorldCore::GetBucket(int CellX, int CellY)
+{
+	return ((unsigned)CellX*73856093u ^ (unsigned)CellY*19349663u)&(GRID_BUCKETS-1);
+}
+
+void CWorldCore::SetCharacter(int ClientID, CCharacterCore *pCore)
+{
+	m_apCharacters[ClientID] = pCore;
+	UpdateCharacter(ClientID);
+}
+
+void CWorldCore::UpdateCharacter(int ClientID)
+{
+	int Bucket = -1;
+	if(m_apCharacters[ClientID])
+	{
+		vec2 Pos = m_apCharacters[ClientID]->m_Pos;
+		Bucket = GetBucket((int)floorf(Pos.x/GRID_CELLSIZE), (int)floorf(Pos.y/GRID_CELLSIZE));
+	}
+
+	if(Bucket == m_aBucket[ClientID])
+		return;
+
+	if(m_aBucket[ClientID] != -1)
+		m_aaGrid[m_aBucket[ClientID]][ClientID/32] &= ~(1u<<(ClientID%32));
+	if(Bucket != -1)
+		m_aaGrid[Bucket][ClientID/32] |= 1u<<(ClientID%32);
+	m_aBucket[ClientID] = Bucket;
+}
+
+void CWorldCore::UpdateCharacters()
+{
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		UpdateCharacter(i);
+}
+
+void CWorldCore::FindCharacters(vec2 From, vec2 To, float Radius, unsigned *pMask) const
+{
+	int FromX = (int)floorf((min(From.x, To.x)-Radius)/GRID_CELLSIZE);
+	int FromY = (int)floorf((min(From.y, To.y)-Radius)/GRID_CELLSIZE);
+	int ToX = (int)floorf((max(From.x, To.x)+Radius)/GRID_CELLSIZE);
+	int ToY = (int)floorf((max(From.y, To.y)+Radius)/GRID_CELLSIZE);
+
+	// long segments would visit every bucket anyway
+	if((ToX-FromX+1)*(ToY-FromY+1) > GRID_MAXCELLS || ToX < FromX || ToY < FromY)
+	{
+		for(int w = 0; w < MASK_WORDS; w++)
+			pMask[w] = ~0u;
+		return;
+	}
+
+	mem_zero(pMask, sizeof(unsigned)*MASK_WORDS);
+	for(int y = FromY; y <= ToY; y++)
+		for(int x = FromX; x <= ToX; x++)
+		{
+			const unsigned *pBucket = m_aaGrid[GetBucket(x, y)];
+			for(int w = 0; w < MASK_WORDS; w++)
+				pMask[w] |= pBucket[w];
+		}
+}
+
 void CCharacterCore::Init(CWorldCore *pWorld, CCollision *pCollision)
 {
 	m_pWorld = pWorld;
@@ -210,10 +271,12 @@ void CCharacterCore::Tick(bool UseInput, const CTuningParams* pTuningParams)
 		if(m_pWorld && pTuningParams->m_PlayerHooking)
 		{
 			float Distance = 0.0f;
+			unsigned aNear[CWorldCore::MASK_WORDS];
+			m_pWorld->FindCharacters(m_HookPos, NewPos, PhysSize+2.0f, aNear);
 			for(int i = 0; i < MAX_CLIENTS; i++)
 			{
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-				if(!pCharCore || pCharCore == this)
+				if(!pCharCore || pCharCore == this || !CWorldCore::InMask(aNear, i))
 					continue;
 
 				vec2 ClosestPoint = closest_point_on_line(m_HookPos, NewPos, pCharCore->m_Pos);
@@ -304,10 +367,13 @@ void CCharacterCore::Tick(bool UseInput, const CTuningParams* pTuningParams)
 
 	if(m_pWorld)
 	{
+		// only the close ones collide, the hooked one is pulled from anywhere
+		unsigned aNear[CWorldCore::MASK_WORDS];
+		m_pWorld->FindCharacters(m_Pos, m_Pos, PhysSize*1.25f, aNear);
 		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
 			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-			if(!pCharCore)
+			if(!pCharCore || (!CWorldCore::InMask(aNear, i) && i != m_HookedPlayer))
 				continue;
 
 			//player *p = (player*)ent;
@@ -373,15 +439,23 @@ void CCharacterCore::Move(const CTuningParams* pTuningParams)
 		float Distance = distance(m_Pos, NewPos);
 		int End = Distance+1;
 		vec2 LastPos = m_Pos;
-		for(int i = 0; i < End; i++)
+
+		// collect the cores along the way once instead of for every step
+		unsigned aNear[CWorldCore::MASK_WORDS];
+		m_pWorld->FindCharacters(m_Pos, NewPos, 28.0f, aNear);
+		int aNearIDs[MAX_CLIENTS];
+		int NumNear = 0;
+		for(int p = 0; p < MAX_CLIENTS; p++)
+			if(CWorldCore::InMask(aNear, p) && m_pWorld->m_apCharacters[p] && m_pWorld->m_apCharacters[p] != this)
+				aNearIDs[NumNear++] = p;
+
+		for(int i = 0; i < End && NumNear; i++)
 		{
 			float a = i/Distance;
 			vec2 Pos = mix(m_Pos, NewPos, a);
-			for(int p = 0; p < MAX_CLIENTS; p++)
+			for(int n = 0; n < NumNear; n++)
 			{
-				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
-				if(!pCharCore || pCharCore == this)
-					continue;
+				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[aNearIDs[n]];
 				float D = distance(Pos, pCharCore->m_Pos);
 				if(D < 28.0f && D > 0.0f)
 				{
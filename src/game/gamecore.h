@@ -170,14 +170,48 @@ enum
 
 class CWorldCore
 {
+public:
+	enum
+	{
+		MASK_WORDS=(MAX_CLIENTS+31)/32,
+	};
+
+private:
+	enum
+	{
+		GRID_CELLSIZE=64,
+		GRID_BUCKETS=128,
+		GRID_MAXCELLS=16,
+	};
+
+	// broadphase for the cores, a hashed grid of cells with one bit per
+	// client in each bucket. buckets may hold more than the cores inside
+	// the cell, the callers test the real positions
+	unsigned m_aaGrid[GRID_BUCKETS][MASK_WORDS];
+	int m_aBucket[MAX_CLIENTS];
+
+	static int GetBucket(int CellX, int CellY);
+
 public:
 	CWorldCore()
 	{
 		mem_zero(m_apCharacters, sizeof(m_apCharacters));
+		mem_zero(m_aaGrid, sizeof(m_aaGrid));
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			m_aBucket[i] = -1;
 	}
 
 	CTuningParams m_Tuning;
 	class CCharacterCore *m_apCharacters[MAX_CLIENTS];
+
+	void SetCharacter(int ClientID, class CCharacterCore *pCore);
+	// call after the core of the client moved
+	void UpdateCharacter(int ClientID);
+	void UpdateCharacters();
+
+	// marks every core that might be closer than Radius to the segment
+	void FindCharacters(vec2 From, vec2 To, float Radius, unsigned *pMask) const;
+	static bool InMask(const unsigned *pMask, int ClientID) { return (pMask[ClientID/32]>>(ClientID%32))&1; }
 };
 
 class CCharacterCore
@@ -139,3 +139,19 @@ void CPickup::Snap(int SnappingClient)
 	pP->m_Type = m_Type;
 	pP->m_Subtype = m_Subtype;
 }
+
+bool CPickup::SnapShared(CSnapCache *pCache, vec2 *pClipPos)
+{
+	if(m_SpawnTick != -1)
+		return true;
+
+	CNetObj_Pickup *pP = static_cast<CNetObj_Pickup *>(pCache->NewItem(NETOBJTYPE_PICKUP, m_ID, sizeof(CNetObj_Pickup)));
+	if(!pP)
+		return true;
+
+	pP->m_X = (int)m_Pos.x;
+	pP->m_Y = (int)m_Pos.y;
+	pP->m_Type = m_Type;
+	pP->m_Subtype = m_Subtype;
+	return true;
+}
@@ -16,6 +16,7 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapShared(class CSnapCache *pCache, vec2 *pClipPos);
 
 private:
 	int m_Type;
@@ -108,3 +108,14 @@ void CProjectile::Snap(int SnappingClient)
 	if(pProj)
 		FillInfo(pProj);
 }
+
+bool CProjectile::SnapShared(CSnapCache *pCache, vec2 *pClipPos)
+{
+	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
+	*pClipPos = GetPos(Ct);
+
+	CNetObj_Projectile *pProj = static_cast<CNetObj_Projectile *>(pCache->NewItem(NETOBJTYPE_PROJECTILE, m_ID, sizeof(CNetObj_Projectile)));
+	if(pProj)
+		FillInfo(pProj);
+	return true;
+}
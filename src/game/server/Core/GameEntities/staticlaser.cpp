@@ -49,3 +49,17 @@ void CStaticlaser::Snap(int SnappingClient)
 	pObj->m_FromY = (int)m_From.y;
 	pObj->m_StartTick = Server()->Tick();
 }
+
+bool CStaticlaser::SnapShared(CSnapCache *pCache, vec2 *pClipPos)
+{
+	CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(pCache->NewItem(NETOBJTYPE_LASER, m_ID, sizeof(CNetObj_Laser)));
+	if(!pObj)
+		return true;
+
+	pObj->m_X = (int)m_Pos.x;
+	pObj->m_Y = (int)m_Pos.y;
+	pObj->m_FromX = (int)m_From.x;
+	pObj->m_FromY = (int)m_From.y;
+	pObj->m_StartTick = Server()->Tick();
+	return true;
+}
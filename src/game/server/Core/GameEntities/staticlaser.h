@@ -12,6 +12,7 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapShared(class CSnapCache *pCache, vec2 *pClipPos);
 
 	vec2 m_From;
 
@@ -124,6 +124,18 @@ public:
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: SnapShared
+			Called once per snapshot tick instead of snap for
+			entities that look the same to every client. Adds the
+			items to the cache, they get copied to every client
+			that doesn't clip pClipPos.
+
+		Returns:
+			False if the entity has to be snapped per client.
+	*/
+	virtual bool SnapShared(class CSnapCache *pCache, vec2 *pClipPos) { return false; }
+
 	/*
 		Function: networkclipped(int snapping_client)
 			Performs a series of test to see if a client can see the
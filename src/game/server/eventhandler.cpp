@@ -9,9 +9,21 @@
 CEventHandler::CEventHandler()
 {
 	m_pGameServer = 0;
+	m_MaxEvents = MIN_EVENTS;
+	m_pEvents = (CEvent *)mem_alloc(sizeof(CEvent)*m_MaxEvents, 1);
+	m_MaxDataSize = MIN_DATASIZE;
+	m_pData = (char *)mem_alloc(m_MaxDataSize, 1);
+	mem_zero(m_aBucketVisits, sizeof(m_aBucketVisits));
+	m_Visit = 0;
 	Clear();
 }
 
+CEventHandler::~CEventHandler()
+{
+	mem_free(m_pEvents);
+	mem_free(m_pData);
+}
+
 void CEventHandler::SetGameServer(CGameContext *pGameServer)
 {
 	m_pGameServer = pGameServer;
@@ -19,16 +31,34 @@ void CEventHandler::SetGameServer(CGameContext *pGameServer)
 
 void *CEventHandler::Create(int Type, int Size, int64_t Mask)
 {
-	if(m_NumEvents == MAX_EVENTS)
-		return 0;
-	if(m_CurrentOffset+Size >= MAX_DATASIZE)
-		return 0;
+	// grow instead of dropping events, the pointers only have to live until the caller filled them in
+	if(m_NumEvents == m_MaxEvents)
+	{
+		CEvent *pEvents = (CEvent *)mem_alloc(sizeof(CEvent)*m_MaxEvents*2, 1);
+		mem_copy(pEvents, m_pEvents, sizeof(CEvent)*m_NumEvents);
+		mem_free(m_pEvents);
+		m_pEvents = pEvents;
+		m_MaxEvents *= 2;
+	}
+	if(m_CurrentOffset+Size >= m_MaxDataSize)
+	{
+		int NewSize = m_MaxDataSize*2;
+		while(m_CurrentOffset+Size >= NewSize)
+			NewSize *= 2;
+		char *pData = (char *)mem_alloc(NewSize, 1);
+		mem_copy(pData, m_pData, m_CurrentOffset);
+		mem_free(m_pData);
+		m_pData = pData;
+		m_MaxDataSize = NewSize;
+	}
 
-	void *p = &m_aData[m_CurrentOffset];
-	m_aOffsets[m_NumEvents] = m_CurrentOffset;
-	m_aTypes[m_NumEvents] = Type;
-	m_aSizes[m_NumEvents] = Size;
-	m_aClientMasks[m_NumEvents] = Mask;
+	void *p = &m_pData[m_CurrentOffset];
+	CEvent *pEvent = &m_pEvents[m_NumEvents];
+	pEvent->m_Offset = m_CurrentOffset;
+	pEvent->m_Type = Type;
+	pEvent->m_Size = Size;
+	pEvent->m_ClientMask = Mask;
+	pEvent->m_Next = -1;
 	m_CurrentOffset += Size;
 	m_NumEvents++;
 	return p;
@@ -38,20 +68,68 @@ void CEventHandler::Clear()
 {
 	m_NumEvents = 0;
 	m_CurrentOffset = 0;
+	m_NumIndexed = 0;
+	for(int i = 0; i < NUM_BUCKETS; i++)
+		m_aBuckets[i] = -1;
+}
+
+void CEventHandler::Index()
+{
+	// the position is only known once the creator filled in the event
+	for(; m_NumIndexed < m_NumEvents; m_NumIndexed++)
+	{
+		CEvent *pEvent = &m_pEvents[m_NumIndexed];
+		CNetEvent_Common *ev = (CNetEvent_Common *)&m_pData[pEvent->m_Offset];
+		int b = Bucket(ev->m_X>>CELL_SHIFT, ev->m_Y>>CELL_SHIFT);
+		pEvent->m_Next = m_aBuckets[b];
+		m_aBuckets[b] = m_NumIndexed;
+	}
+}
+
+void CEventHandler::SnapEvent(int Index)
+{
+	CEvent *pEvent = &m_pEvents[Index];
+	void *d = GameServer()->Server()->SnapNewItem(pEvent->m_Type, Index, pEvent->m_Size);
+	if(d)
+		mem_copy(d, &m_pData[pEvent->m_Offset], pEvent->m_Size);
 }
 
 void CEventHandler::Snap(int SnappingClient)
 {
-	for(int i = 0; i < m_NumEvents; i++)
+	if(SnappingClient == -1)
 	{
-		if(SnappingClient == -1 || CmaskIsSet(m_aClientMasks[i], SnappingClient))
+		for(int i = 0; i < m_NumEvents; i++)
+			SnapEvent(i);
+		return;
+	}
+
+	Index();
+
+	vec2 ViewPos = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos;
+	int StartX = ((int)ViewPos.x-VIEW_DISTANCE)>>CELL_SHIFT;
+	int StartY = ((int)ViewPos.y-VIEW_DISTANCE)>>CELL_SHIFT;
+	int EndX = ((int)ViewPos.x+VIEW_DISTANCE)>>CELL_SHIFT;
+	int EndY = ((int)ViewPos.y+VIEW_DISTANCE)>>CELL_SHIFT;
+
+	// cells can share a bucket, visit each bucket once
+	m_Visit++;
+	for(int y = StartY; y <= EndY; y++)
+	{
+		for(int x = StartX; x <= EndX; x++)
 		{
-			CNetEvent_Common *ev = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
-			if(SnappingClient == -1 || distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, vec2(ev->m_X, ev->m_Y)) < 1500.0f)
+			int b = Bucket(x, y);
+			if(m_aBucketVisits[b] == m_Visit)
+				continue;
+			m_aBucketVisits[b] = m_Visit;
+
+			for(int i = m_aBuckets[b]; i >= 0; i = m_pEvents[i].m_Next)
 			{
-				void *d = GameServer()->Server()->SnapNewItem(m_aTypes[i], i, m_aSizes[i]);
-				if(d)
-					mem_copy(d, &m_aData[m_aOffsets[i]], m_aSizes[i]);
+				if(!CmaskIsSet(m_pEvents[i].m_ClientMask, SnappingClient))
+					continue;
+
+				CNetEvent_Common *ev = (CNetEvent_Common *)&m_pData[m_pEvents[i].m_Offset];
+				if(distance(ViewPos, vec2(ev->m_X, ev->m_Y)) < (float)VIEW_DISTANCE)
+					SnapEvent(i);
 			}
 		}
 	}
@@ -15,24 +15,50 @@ typedef unsigned __int64 uint64_t;
 //
 class CEventHandler
 {
-	static const int MAX_EVENTS = 128;
-	static const int MAX_DATASIZE = 128*64;
+	enum
+	{
+		// events are bucketed by position so a snap only looks at the ones nearby
+		CELL_SHIFT=9, // 512 units
+		NUM_BUCKETS=256,
+		VIEW_DISTANCE=1500,
 
-	int m_aTypes[MAX_EVENTS]; // TODO: remove some of these arrays
-	int m_aOffsets[MAX_EVENTS];
-	int m_aSizes[MAX_EVENTS];
-	int64_t m_aClientMasks[MAX_EVENTS];
-	char m_aData[MAX_DATASIZE];
+		MIN_EVENTS=128,
+		MIN_DATASIZE=128*64,
+	};
+
+	struct CEvent
+	{
+		int m_Type;
+		int m_Offset;
+		int m_Size;
+		int64_t m_ClientMask;
+		int m_Next;
+	};
+
+	CEvent *m_pEvents;
+	int m_MaxEvents;
+	char *m_pData;
+	int m_MaxDataSize;
+
+	int m_aBuckets[NUM_BUCKETS];
+	int m_aBucketVisits[NUM_BUCKETS];
+	int m_NumIndexed;
+	int m_Visit;
 
 	class CGameContext *m_pGameServer;
 
 	int m_CurrentOffset;
 	int m_NumEvents;
+
+	static int Bucket(int x, int y) { return ((unsigned)x*73856093u ^ (unsigned)y*19349663u)&(NUM_BUCKETS-1); }
+	void Index();
+	void SnapEvent(int Index);
 public:
 	CGameContext *GameServer() const { return m_pGameServer; }
 	void SetGameServer(CGameContext *pGameServer);
 
 	CEventHandler();
+	~CEventHandler();
 	void *Create(int Type, int Size, int64_t Mask = -1LL);
 	void Clear();
 	void Snap(int SnappingClient);
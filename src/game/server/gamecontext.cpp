@@ -244,19 +244,29 @@ void CGameContext::SendChatTarget(int To, const char *pText, ...)
 	Msg.m_ClientID = -1;
 	
 	dynamic_string Buffer;
+	bool aDone[MAX_CLIENTS] = {0};
 	
 	va_list VarArgs;
 	va_start(VarArgs, pText);
 	
+	// format once per language and send it to everyone speaking it
 	for(int i = Start; i < End; i++)
 	{
-		if(m_apPlayers[i])
+		if(!m_apPlayers[i] || aDone[i])
+			continue;
+		
+		int Language = m_apPlayers[i]->GetLanguageHandle();
+		Buffer.clear();
+		Server()->Localization()->Format_VL(Buffer, Language, pText, VarArgs);
+		Msg.m_pMessage = Buffer.buffer();
+		
+		for(int j = i; j < End; j++)
 		{
-			Buffer.clear();
-			Server()->Localization()->Format_VL(Buffer, m_apPlayers[i]->GetLanguage(), pText, VarArgs);
-			
-			Msg.m_pMessage = Buffer.buffer();
-			Server()->SendPackMsg(&Msg, MSGFLAG_VITAL, i);
+			if(m_apPlayers[j] && !aDone[j] && m_apPlayers[j]->GetLanguageHandle() == Language)
+			{
+				aDone[j] = true;
+				Server()->SendPackMsg(&Msg, MSGFLAG_VITAL, j);
+			}
 		}
 	}
 	
@@ -342,16 +352,24 @@ void CGameContext::SendBroadcast_VL(const char *pText, int ClientID, ...)
 		Server()->SendPackMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_NOSEND, -1);
 	}
 
+	bool aDone[MAX_CLIENTS] = {0};
 	for(int i = Start; i < End; i++)
 	{
-		if(m_apPlayers[i])
+		if(!m_apPlayers[i] || aDone[i])
+			continue;
+		
+		int Language = m_apPlayers[i]->GetLanguageHandle();
+		Buffer.clear();
+		Server()->Localization()->Format_VL(Buffer, Language, _(pText), VarArgs);
+		Msg.m_pMessage = Buffer.buffer();
+		
+		for(int j = i; j < End; j++)
 		{
-			Buffer.clear();
-			Server()->Localization()->Format_VL(Buffer, m_apPlayers[i]->GetLanguage(), _(pText), VarArgs);
-			
-			Msg.m_pMessage = Buffer.buffer();
-			Server()->SendPackMsg(&Msg, MSGFLAG_VITAL, i);
-			
+			if(m_apPlayers[j] && !aDone[j] && m_apPlayers[j]->GetLanguageHandle() == Language)
+			{
+				aDone[j] = true;
+				Server()->SendPackMsg(&Msg, MSGFLAG_VITAL, j);
+			}
 		}
 	}
 	
@@ -359,6 +377,16 @@ void CGameContext::SendBroadcast_VL(const char *pText, int ClientID, ...)
 }
 
 //
+void CGameContext::UpdateVoteClient(int ClientID)
+{
+	if(!m_apPlayers[ClientID])
+		return;
+
+	char aAddr[NETADDR_MAXSTRSIZE] = {0};
+	Server()->GetClientAddr(ClientID, aAddr, sizeof(aAddr));
+	m_VoteTally.SetClient(ClientID, aAddr, m_apPlayers[ClientID]->GetTeam() != TEAM_SPECTATORS);
+}
+
 void CGameContext::StartVote(const char *pDesc, const char *pCommand, const char *pReason)
 {
 	// check if a vote is already running
@@ -375,6 +403,7 @@ void CGameContext::StartVote(const char *pDesc, const char *pCommand, const char
 			m_apPlayers[i]->m_VotePos = 0;
 		}
 	}
+	m_VoteTally.ClearVotes();
 
 	// start vote
 	m_VoteCloseTime = time_get() + time_freq()*25;
@@ -502,39 +531,9 @@ void CGameContext::OnTick()
 			if(m_VoteUpdate)
 			{
 				// count votes
-				char aaBuf[MAX_CLIENTS][NETADDR_MAXSTRSIZE] = {{0}};
-				for(int i = 0; i < MAX_CLIENTS; i++)
-					if(m_apPlayers[i])
-						Server()->GetClientAddr(i, aaBuf[i], NETADDR_MAXSTRSIZE);
-				bool aVoteChecked[MAX_CLIENTS] = {0};
-				for(int i = 0; i < MAX_CLIENTS; i++)
-				{
-					if(!m_apPlayers[i] || m_apPlayers[i]->GetTeam() == TEAM_SPECTATORS || aVoteChecked[i])	// don't count in votes by spectators
-						continue;
-
-					int ActVote = m_apPlayers[i]->m_Vote;
-					int ActVotePos = m_apPlayers[i]->m_VotePos;
-
-					// check for more players with the same ip (only use the vote of the one who voted first)
-					for(int j = i+1; j < MAX_CLIENTS; ++j)
-					{
-						if(!m_apPlayers[j] || aVoteChecked[j] || str_comp(aaBuf[j], aaBuf[i]))
-							continue;
-
-						aVoteChecked[j] = true;
-						if(m_apPlayers[j]->m_Vote && (!ActVote || ActVotePos > m_apPlayers[j]->m_VotePos))
-						{
-							ActVote = m_apPlayers[j]->m_Vote;
-							ActVotePos = m_apPlayers[j]->m_VotePos;
-						}
-					}
-
-					Total++;
-					if(ActVote > 0)
-						Yes++;
-					else if(ActVote < 0)
-						No++;
-				}
+				Total = m_VoteTally.Total();
+				Yes = m_VoteTally.Yes();
+				No = m_VoteTally.No();
 
 				if(Yes >= Total/2+1)
 					m_VoteEnforce = VOTE_ENFORCE_YES;
@@ -604,6 +603,8 @@ void CGameContext::OnClientEnter(int ClientID)
 	str_format(aBuf, sizeof(aBuf), "team_join player='%d:%s' team=%d", ClientID, Server()->ClientName(ClientID), m_apPlayers[ClientID]->GetTeam());
 	Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "game", aBuf);
 
+	// the address is only known once the client is in game
+	UpdateVoteClient(ClientID);
 	m_VoteUpdate = true;
 }
 
@@ -613,6 +614,7 @@ void CGameContext::OnClientConnected(int ClientID)
 	const int StartTeam = g_Config.m_SvTournamentMode ? TEAM_SPECTATORS : m_pController->GetAutoTeam(ClientID);
 
 	m_apPlayers[ClientID] = new(ClientID) CPlayer(this, ClientID, StartTeam);
+	UpdateVoteClient(ClientID);
 	//players[client_id].init(client_id);
 	//players[client_id].client_id = client_id;
 
@@ -642,6 +644,7 @@ void CGameContext::OnClientDrop(int ClientID, const char *pReason)
 	m_apPlayers[ClientID]->OnDisconnect(pReason);
 	delete m_apPlayers[ClientID];
 	m_apPlayers[ClientID] = 0;
+	m_VoteTally.RemoveClient(ClientID);
 
 	(void)m_pController->CheckTeamBalance();
 	m_VoteUpdate = true;
@@ -899,6 +902,7 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 				StartVote(aDesc, aCmd, pReason);
 				pPlayer->m_Vote = 1;
 				pPlayer->m_VotePos = m_VotePos = 1;
+				m_VoteTally.SetVote(ClientID, pPlayer->m_Vote, pPlayer->m_VotePos);
 				m_VoteCreator = ClientID;
 				pPlayer->m_LastVoteCall = Now;
 			}
@@ -916,6 +920,7 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 
 				pPlayer->m_Vote = pMsg->m_Vote;
 				pPlayer->m_VotePos = ++m_VotePos;
+				m_VoteTally.SetVote(ClientID, pPlayer->m_Vote, pPlayer->m_VotePos);
 				m_VoteUpdate = true;
 			}
 		}
@@ -1714,6 +1719,9 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 	for(int i = 0; i < NUM_NETOBJTYPES; i++)
 		Server()->SnapSetStaticsize(i, m_NetObjHandler.GetObjSize(i));
 
+	// looked up for every shot and hit, table them before the game starts
+	InitWeaponProperties();
+
 	m_Layers.Init(Kernel());
 	m_Collision.Init(&m_Layers);
 	m_MapGen.Init(&m_Layers, &m_Collision, m_pStorage); // MapGen
@@ -2137,16 +2145,15 @@ void CGameContext::SaveMap(const char *path)
 		return;
 
 	CDataFileWriter fileWrite;
-	char aMapFile[512];
-	//str_format(aMapFile, sizeof(aMapFile), "maps/{%s}_{%d}.map", Server()->GetMapName(), g_Config.m_SvMapGenSeed);
-	str_format(aMapFile, sizeof(aMapFile), "maps/generated.map");
-
-	// Map will be saved to current dir, not to ~/.ninslash/maps or to data/maps, so we need to create a dir for it
-	Storage()->CreateFolder("maps", IStorage::TYPE_SAVE);
+	unsigned char *pData = 0;
+	unsigned Size = 0;
+	if(!fileWrite.SaveMapToMemory(pMap->GetFileReader(), &pData, &Size))
+		return;
 
-	fileWrite.SaveMap(Storage(), pMap->GetFileReader(), aMapFile);
+	// hand the image straight to the server, the disk copy is optional and written in the background
+	Server()->SetGeneratedMap("generated", pData, Size, g_Config.m_SvMapGenSave);
 
 	char aBuf[128];
-	str_format(aBuf, sizeof(aBuf), "Map saved in '{%s}'!", aMapFile);
+	str_format(aBuf, sizeof(aBuf), "Map generated (%d bytes)", Size);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
@@ -18,6 +18,7 @@
 #include "gameworld.h"
 #include "player.h"
 #include "mapgen.h"
+#include "votetally.h"
 
 #ifdef _MSC_VER
 typedef __int32 int32_t;
@@ -148,7 +149,10 @@ public:
 	void SendVoteSet(int ClientID);
 	void SendVoteStatus(int ClientID, int Total, int Yes, int No);
 	void AbortVoteKickOnDisconnect(int ClientID);
+	// refreshes the address and team of the client in the vote tally
+	void UpdateVoteClient(int ClientID);
 
+	CVoteTally m_VoteTally;
 	int m_VoteCreator;
 	int64 m_VoteCloseTime;
 	bool m_VoteUpdate;
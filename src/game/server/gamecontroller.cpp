@@ -40,40 +40,123 @@ IGameController::~IGameController()
 {
 }
 
-float IGameController::EvaluateSpawnPos(CSpawnEval *pEval, vec2 Pos)
+void IGameController::PrepareSpawnEval(CSpawnEval *pEval)
 {
-	float Score = 0.0f;
+	pEval->m_Prepared = true;
+	pEval->m_NumChars = 0;
+	pEval->m_NumCells = 0;
+
 	CCharacter *pC = static_cast<CCharacter *>(GameServer()->m_World.FindFirst(CGameWorld::ENTTYPE_CHARACTER));
-	for(; pC; pC = (CCharacter *)pC->TypeNext())
+	for(; pC && pEval->m_NumChars < CSpawnEval::MAX_CHARS; pC = (CCharacter *)pC->TypeNext())
 	{
 		// team mates are not as dangerous as enemies
 		float Scoremod = 1.0f;
 		if(pEval->m_FriendlyTeam != -1 && pC->GetPlayer()->GetTeam() == pEval->m_FriendlyTeam)
 			Scoremod = 0.5f;
 
-		float d = distance(Pos, pC->m_Pos);
-		Score += Scoremod * (d == 0 ? 1000000000.0f : 1.0f/d);
+		int x = round_to_int(pC->m_Pos.x)>>CSpawnEval::CELL_SHIFT;
+		int y = round_to_int(pC->m_Pos.y)>>CSpawnEval::CELL_SHIFT;
+		int Cell = 0;
+		while(Cell < pEval->m_NumCells && (pEval->m_aCells[Cell].m_X != x || pEval->m_aCells[Cell].m_Y != y))
+			Cell++;
+		if(Cell == pEval->m_NumCells)
+		{
+			CSpawnEval::CCell *pCell = &pEval->m_aCells[pEval->m_NumCells++];
+			pCell->m_X = x;
+			pCell->m_Y = y;
+			pCell->m_Weight = 0.0f;
+			pCell->m_Centroid = vec2(0.0f, 0.0f);
+			pCell->m_First = -1;
+		}
+
+		CSpawnEval::CCell *pCell = &pEval->m_aCells[Cell];
+		CSpawnEval::CChar *pChar = &pEval->m_aChars[pEval->m_NumChars];
+		pChar->m_Pos = pC->m_Pos;
+		pChar->m_Radius = pC->m_ProximityRadius;
+		pChar->m_Weight = Scoremod;
+		pChar->m_Next = pCell->m_First;
+		pCell->m_First = pEval->m_NumChars++;
+		pCell->m_Weight += Scoremod;
+		pCell->m_Centroid += pC->m_Pos*Scoremod;
+	}
+
+	for(int i = 0; i < pEval->m_NumCells; i++)
+		pEval->m_aCells[i].m_Centroid = pEval->m_aCells[i].m_Centroid/pEval->m_aCells[i].m_Weight;
+}
+
+float IGameController::EvaluateSpawnPos(CSpawnEval *pEval, vec2 Pos)
+{
+	if(!pEval->m_Prepared)
+		PrepareSpawnEval(pEval);
+
+	int x = round_to_int(Pos.x)>>CSpawnEval::CELL_SHIFT;
+	int y = round_to_int(Pos.y)>>CSpawnEval::CELL_SHIFT;
+
+	float Score = 0.0f;
+	for(int i = 0; i < pEval->m_NumCells; i++)
+	{
+		const CSpawnEval::CCell *pCell = &pEval->m_aCells[i];
+		if(absolute(pCell->m_X-x) > CSpawnEval::NEAR_CELLS || absolute(pCell->m_Y-y) > CSpawnEval::NEAR_CELLS)
+		{
+			// far enough for the cell to look like one point
+			Score += pCell->m_Weight/distance(Pos, pCell->m_Centroid);
+			continue;
+		}
+
+		for(int c = pCell->m_First; c >= 0; c = pEval->m_aChars[c].m_Next)
+		{
+			float d = distance(Pos, pEval->m_aChars[c].m_Pos);
+			Score += pEval->m_aChars[c].m_Weight * (d == 0 ? 1000000000.0f : 1.0f/d);
+		}
 	}
 
 	return Score;
 }
 
+void IGameController::EvaluateSpawnBatch(CSpawnEval *pEval, const vec2 *pCandidates, int Num)
+{
+	if(!pEval->m_Prepared)
+		PrepareSpawnEval(pEval);
+
+	for(int i = 0; i < Num; i++)
+	{
+		float S = EvaluateSpawnPos(pEval, pCandidates[i]);
+		if(!pEval->m_Got || pEval->m_Score > S)
+		{
+			pEval->m_Got = true;
+			pEval->m_Score = S;
+			pEval->m_Pos = pCandidates[i];
+		}
+	}
+}
+
 void IGameController::EvaluateSpawnType(CSpawnEval *pEval, int Type)
 {
+	if(!pEval->m_Prepared)
+		PrepareSpawnEval(pEval);
+
+	vec2 aCandidates[64];
+	int NumCandidates = 0;
+
 	// get spawn point
 	for(int i = 0; i < m_aNumSpawnPoints[Type]; i++)
 	{
-		// check if the position is occupado
-		CCharacter *aEnts[MAX_CLIENTS];
-		int Num = GameServer()->m_World.FindEntities(m_aaSpawnPoints[Type][i], 64, (CEntity**)aEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
+		// check if the position is occupado, only characters touching the spawn point matter
+		vec2 SpawnPoint = m_aaSpawnPoints[Type][i];
+		int aNear[CSpawnEval::MAX_CHARS];
+		int Num = 0;
+		for(int c = 0; c < pEval->m_NumChars; c++)
+			if(distance(pEval->m_aChars[c].m_Pos, SpawnPoint) < 64+pEval->m_aChars[c].m_Radius)
+				aNear[Num++] = c;
+
 		vec2 Positions[5] = { vec2(0.0f, 0.0f), vec2(-32.0f, 0.0f), vec2(0.0f, -32.0f), vec2(32.0f, 0.0f), vec2(0.0f, 32.0f) };	// start, left, up, right, down
 		int Result = -1;
 		for(int Index = 0; Index < 5 && Result == -1; ++Index)
 		{
 			Result = Index;
 			for(int c = 0; c < Num; ++c)
-				if(GameServer()->Collision()->CheckPoint(m_aaSpawnPoints[Type][i]+Positions[Index]) ||
-					distance(aEnts[c]->m_Pos, m_aaSpawnPoints[Type][i]+Positions[Index]) <= aEnts[c]->m_ProximityRadius)
+				if(GameServer()->Collision()->CheckPoint(SpawnPoint+Positions[Index]) ||
+					distance(pEval->m_aChars[aNear[c]].m_Pos, SpawnPoint+Positions[Index]) <= pEval->m_aChars[aNear[c]].m_Radius)
 				{
 					Result = -1;
 					break;
@@ -82,15 +165,10 @@ void IGameController::EvaluateSpawnType(CSpawnEval *pEval, int Type)
 		if(Result == -1)
 			continue;	// try next spawn point
 
-		vec2 P = m_aaSpawnPoints[Type][i]+Positions[Result];
-		float S = EvaluateSpawnPos(pEval, P);
-		if(!pEval->m_Got || pEval->m_Score > S)
-		{
-			pEval->m_Got = true;
-			pEval->m_Score = S;
-			pEval->m_Pos = P;
-		}
+		aCandidates[NumCandidates++] = SpawnPoint+Positions[Result];
 	}
+
+	EvaluateSpawnBatch(pEval, aCandidates, NumCandidates);
 }
 
 bool IGameController::CanSpawn(int Team, vec2 *pOutPos)
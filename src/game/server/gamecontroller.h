@@ -38,16 +38,52 @@ protected:
 			m_Got = false;
 			m_FriendlyTeam = -1;
 			m_Pos = vec2(100,100);
+			m_Prepared = false;
 		}
 
 		vec2 m_Pos;
 		bool m_Got;
 		int m_FriendlyTeam;
 		float m_Score;
+
+		// the characters are gathered once per evaluation and bucketed in
+		// coarse cells, far away cells are scored by their centroid
+		enum
+		{
+			MAX_CHARS=64,
+			CELL_SHIFT=9, // 512 units
+			NEAR_CELLS=2,
+		};
+
+		struct CChar
+		{
+			vec2 m_Pos;
+			float m_Radius;
+			float m_Weight;
+			int m_Next;
+		};
+
+		struct CCell
+		{
+			int m_X;
+			int m_Y;
+			float m_Weight;
+			vec2 m_Centroid;
+			int m_First;
+		};
+
+		bool m_Prepared;
+		int m_NumChars;
+		int m_NumCells;
+		CChar m_aChars[MAX_CHARS];
+		CCell m_aCells[MAX_CHARS];
 	};
 
+	void PrepareSpawnEval(CSpawnEval *pEval);
 	float EvaluateSpawnPos(CSpawnEval *pEval, vec2 Pos);
 	void EvaluateSpawnType(CSpawnEval *pEval, int Type);
+	// scores all the candidates against the same character grid and keeps the best
+	void EvaluateSpawnBatch(CSpawnEval *pEval, const vec2 *pCandidates, int Num);
 	bool EvaluateSpawn(class CPlayer *pP, vec2 *pPos);
 
 	void CycleMap();
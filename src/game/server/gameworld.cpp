@@ -9,11 +9,44 @@
 #include <utility>
 #include <engine/shared/config.h>
 
+//////////////////////////////////////////////////
+// snap cache
+//////////////////////////////////////////////////
+void CSnapCache::Clear()
+{
+	m_NumEntries = 0;
+	m_NumItems = 0;
+	m_DataSize = 0;
+	m_Overflow = false;
+	m_Tick = -1;
+}
+
+void *CSnapCache::NewItem(int Type, int ID, int Size)
+{
+	int Ints = Size/(int)sizeof(int);
+	if(m_NumItems == MAX_ITEMS || m_DataSize+Ints > MAX_DATA)
+	{
+		m_Overflow = true;
+		return 0;
+	}
+
+	CItem *pItem = &m_aItems[m_NumItems++];
+	pItem->m_Type = Type;
+	pItem->m_ID = ID;
+	pItem->m_Size = Size;
+	pItem->m_Offset = m_DataSize;
+	mem_zero(&m_aData[m_DataSize], Ints*sizeof(int));
+	m_DataSize += Ints;
+	return &m_aData[pItem->m_Offset];
+}
+
 //////////////////////////////////////////////////
 // game world
 //////////////////////////////////////////////////
 CGameWorld::CGameWorld()
 {
+	m_SnapCache.Clear();
+
 	m_pGameServer = 0x0;
 	m_pServer = 0x0;
 
@@ -65,6 +98,8 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 
 void CGameWorld::InsertEntity(CEntity *pEnt)
 {
+	m_SnapCache.m_Tick = -1;
+
 #ifdef CONF_DEBUG
 	for(CEntity *pCur = m_apFirstEntityTypes[pEnt->m_ObjType]; pCur; pCur = pCur->m_pNextTypeEntity)
 		dbg_assert(pCur != pEnt, "err");
@@ -85,6 +120,8 @@ void CGameWorld::DestroyEntity(CEntity *pEnt)
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
 {
+	m_SnapCache.m_Tick = -1;
+
 	// not in the list
 	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
 		return;
@@ -106,13 +143,64 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 }
 
 //
+void CGameWorld::BuildSnapCache()
+{
+	m_SnapCache.Clear();
+	m_SnapCache.m_Tick = Server()->Tick();
+
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt && m_SnapCache.m_NumEntries < CSnapCache::MAX_ENTRIES; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			CSnapCache::CEntry *pEntry = &m_SnapCache.m_aEntries[m_SnapCache.m_NumEntries];
+			pEntry->m_pEntity = pEnt;
+			pEntry->m_ClipPos = pEnt->m_Pos;
+			pEntry->m_FirstItem = m_SnapCache.m_NumItems;
+			int DataSize = m_SnapCache.m_DataSize;
+
+			if(!pEnt->SnapShared(&m_SnapCache, &pEntry->m_ClipPos))
+				continue;
+
+			// out of space, this one gets snapped per client
+			if(m_SnapCache.m_Overflow)
+			{
+				m_SnapCache.m_NumItems = pEntry->m_FirstItem;
+				m_SnapCache.m_DataSize = DataSize;
+				m_SnapCache.m_Overflow = false;
+				continue;
+			}
+
+			pEntry->m_NumItems = m_SnapCache.m_NumItems-pEntry->m_FirstItem;
+			m_SnapCache.m_NumEntries++;
+		}
+}
+
 void CGameWorld::Snap(int SnappingClient)
 {
+	if(m_SnapCache.m_Tick != Server()->Tick())
+		BuildSnapCache();
+
+	// the cache lists its entities in traversal order
+	int Cached = 0;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
+			if(Cached < m_SnapCache.m_NumEntries && m_SnapCache.m_aEntries[Cached].m_pEntity == pEnt)
+			{
+				const CSnapCache::CEntry *pEntry = &m_SnapCache.m_aEntries[Cached++];
+				if(!pEnt->NetworkClipped(SnappingClient, pEntry->m_ClipPos))
+				{
+					for(int j = 0; j < pEntry->m_NumItems; j++)
+					{
+						const CSnapCache::CItem *pItem = &m_SnapCache.m_aItems[pEntry->m_FirstItem+j];
+						void *pData = Server()->SnapNewItem(pItem->m_Type, pItem->m_ID, pItem->m_Size);
+						if(pData)
+							mem_copy(pData, &m_SnapCache.m_aData[pItem->m_Offset], pItem->m_Size);
+					}
+				}
+			}
+			else
+				pEnt->Snap(SnappingClient);
 			pEnt = m_pNextTraverseEntity;
 		}
 }
@@ -153,6 +241,8 @@ void CGameWorld::RemoveEntities()
 
 void CGameWorld::Tick()
 {
+	m_SnapCache.m_Tick = -1;
+
 	if(m_ResetRequested)
 		Reset();
 
@@ -160,6 +250,10 @@ void CGameWorld::Tick()
 	{
 		if(GameServer()->m_pController->IsForceBalanced())
 			GameServer()->SendChat(-1, CGameContext::CHAT_ALL, "Teams have been balanced");
+
+		// pick up the cores that were moved outside of the tick
+		m_Core.UpdateCharacters();
+
 		// update all objects
 		for(int i = 0; i < NUM_ENTTYPES; i++)
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
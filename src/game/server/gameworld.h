@@ -8,6 +8,51 @@
 class CEntity;
 class CCharacter;
 
+/*
+	Class: Snap Cache
+		Snapshot items of the entities that look the same to every
+		client. Built once per snapshot tick, then only clipped and
+		copied into each client's snapshot.
+*/
+class CSnapCache
+{
+public:
+	enum
+	{
+		MAX_ENTRIES=1024,
+		MAX_ITEMS=2048,
+		MAX_DATA=16*1024, // in ints
+	};
+
+	struct CEntry
+	{
+		CEntity *m_pEntity;
+		vec2 m_ClipPos;
+		int m_FirstItem;
+		int m_NumItems;
+	};
+
+	struct CItem
+	{
+		int m_Type;
+		int m_ID;
+		int m_Size;
+		int m_Offset;
+	};
+
+	CEntry m_aEntries[MAX_ENTRIES];
+	int m_NumEntries;
+	CItem m_aItems[MAX_ITEMS];
+	int m_NumItems;
+	int m_aData[MAX_DATA];
+	int m_DataSize;
+	bool m_Overflow;
+	int m_Tick;
+
+	void Clear();
+	void *NewItem(int Type, int ID, int Size);
+};
+
 /*
 	Class: Game World
 		Tracks all entities in the game. Propagates tick and
@@ -36,6 +81,9 @@ private:
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	CSnapCache m_SnapCache;
+	void BuildSnapCache();
+
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
 
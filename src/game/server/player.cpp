@@ -331,6 +331,7 @@ void CPlayer::SetTeam(int Team, bool DoChatMsg)
 	KillCharacter();
 
 	m_Team = Team;
+	GameServer()->UpdateVoteClient(m_ClientID);
 	m_LastActionTick = Server()->Tick();
 	m_SpectatorID = SPEC_FREEVIEW;
 	// we got to wait 0.5 secs before respawning
@@ -372,6 +373,7 @@ const char* CPlayer::GetLanguage()
 void CPlayer::SetLanguage(const char* pLanguage)
 {
 	str_copy(m_aLanguage, pLanguage, sizeof(m_aLanguage));
+	m_Language = Server()->Localization()->GetLanguageHandle(m_aLanguage);
 }
 
 void CPlayer::SetAISkin()
@@ -74,6 +74,7 @@ public:
 	CCharacter *GetCharacter();
 
 	const char* GetLanguage();
+	int GetLanguageHandle() const { return m_Language; }
 	void SetLanguage(const char* pLanguage);
 
 	//---------------------------------------------------------
@@ -172,6 +173,7 @@ private:
 	int m_Team;
 
 	char m_aLanguage[16];
+	int m_Language;
 
 	private:
 	CTuningParams m_PrevTuningParams;
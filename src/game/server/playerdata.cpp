@@ -1,16 +1,44 @@
 #include <base/system.h>
 #include <base/math.h>
 
+#include <engine/storage.h>
+#include <engine/shared/packer.h>
+
 #include "playerdata.h"
 
+static const unsigned char SNAPSHOT_MAGIC[] = {'p', 'd', 'a', 't'};
+
+static unsigned RecordChecksum(const unsigned char *pData, int Size)
+{
+	// fnv-1a
+	unsigned Hash = 2166136261u;
+	for(int i = 0; i < Size; i++)
+		Hash = (Hash^pData[i])*16777619u;
+	return Hash;
+}
+
+static void WriteUInt(unsigned char *pDst, unsigned Value)
+{
+	pDst[0] = Value&0xff;
+	pDst[1] = (Value>>8)&0xff;
+	pDst[2] = (Value>>16)&0xff;
+	pDst[3] = (Value>>24)&0xff;
+}
+
+static unsigned ReadUInt(const unsigned char *pSrc)
+{
+	return pSrc[0] | (pSrc[1]<<8) | (pSrc[2]<<16) | ((unsigned)pSrc[3]<<24);
+}
+
 CPlayerData::CPlayerData(const char *pName, int ColorID)
 {
-	m_pChild1 = 0;
-	m_pChild2 = 0;
-	
+	m_pNext = 0;
+	m_Hash = 0;
+	m_SavedLevel = 0;
+
 	str_copy(m_aName, pName, 16);
 	m_ColorID = ColorID;
-	
+
 	Reset();
 }
 
@@ -18,94 +46,438 @@ void CPlayerData::Die()
 {
 }
 
-void CPlayerData::Add(CPlayerData *pPlayerData)
+void CPlayerData::Reset()
 {
-	int Color = pPlayerData->m_ColorID;
-	
-	if (Color < m_ColorID)
+	for (int i = 0; i < NUM_SLOTS; i++)
 	{
-		if (m_pChild1)
-			m_pChild1->Add(pPlayerData);
-		else
-			m_pChild1 = pPlayerData;
+		m_aWeaponType[i] = 0;
+		m_aWeaponAmmo[i] = 0;
+
+		m_aAmmo[i] = -1;
 	}
-	else
+
+	m_Armor = 0;
+	m_Weapon = 0;
+	m_Kits = 0;
+	m_Score = 0;
+	m_Gold = 0;
+	m_HighestLevel = 0;
+	m_HighestLevelSeed = 0;
+}
+
+void CPlayerData::Pack(CPacker *pPacker) const
+{
+	pPacker->AddInt(m_Weapon);
+	pPacker->AddInt(m_Armor);
+	pPacker->AddInt(m_Kits);
+	pPacker->AddInt(m_Score);
+	pPacker->AddInt(m_Gold);
+	pPacker->AddInt(m_HighestLevel);
+	pPacker->AddInt(m_HighestLevelSeed);
+
+	int NumSlots = 0;
+	for (int i = 0; i < NUM_SLOTS; i++)
+		if (m_aWeaponType[i] || m_aWeaponAmmo[i] || m_aAmmo[i] != -1)
+			NumSlots++;
+
+	pPacker->AddInt(NumSlots);
+	for (int i = 0; i < NUM_SLOTS; i++)
 	{
-		if (m_pChild2)
-			m_pChild2->Add(pPlayerData);
-		else
-			m_pChild2 = pPlayerData;
+		if (!m_aWeaponType[i] && !m_aWeaponAmmo[i] && m_aAmmo[i] == -1)
+			continue;
+
+		pPacker->AddInt(i);
+		pPacker->AddInt(m_aWeaponType[i]);
+		pPacker->AddInt(m_aWeaponAmmo[i]);
+		pPacker->AddInt(m_aAmmo[i]);
 	}
 }
 
-CPlayerData *CPlayerData::Get(const char *pName, int ColorID)
+bool CPlayerData::Unpack(CUnpacker *pUnpacker)
 {
-	if (ColorID == m_ColorID)
+	Reset();
+
+	m_Weapon = pUnpacker->GetInt();
+	m_Armor = pUnpacker->GetInt();
+	m_Kits = pUnpacker->GetInt();
+	m_Score = pUnpacker->GetInt();
+	m_Gold = pUnpacker->GetInt();
+	m_HighestLevel = pUnpacker->GetInt();
+	m_HighestLevelSeed = pUnpacker->GetInt();
+
+	int NumSlots = pUnpacker->GetInt();
+	if (NumSlots < 0 || NumSlots > NUM_SLOTS)
+		return false;
+
+	for (int n = 0; n < NumSlots; n++)
 	{
-		if(str_comp(pName, m_aName) == 0)
-			return this;
+		int i = pUnpacker->GetInt();
+		if (pUnpacker->Error() || i < 0 || i >= NUM_SLOTS)
+			return false;
+
+		m_aWeaponType[i] = pUnpacker->GetInt();
+		m_aWeaponAmmo[i] = pUnpacker->GetInt();
+		m_aAmmo[i] = pUnpacker->GetInt();
 	}
-	
-	if (ColorID < m_ColorID)
+
+	return !pUnpacker->Error();
+}
+
+
+CPlayerDataStore::CPlayerDataStore()
+{
+	m_apHash = 0;
+	m_HashSize = 0;
+	m_NumPlayers = 0;
+	m_HighScore = 0;
+	m_pStorage = 0;
+	m_aSnapshotFile[0] = 0;
+	m_aBackupFile[0] = 0;
+	m_aJournalFile[0] = 0;
+	m_aJournalBackupFile[0] = 0;
+	m_Journal = 0;
+	m_JournalSize = 0;
+}
+
+CPlayerDataStore::~CPlayerDataStore()
+{
+	if(m_Journal)
+		io_close(m_Journal);
+	Clear();
+}
+
+unsigned CPlayerDataStore::Hash(const char *pName, int ColorID)
+{
+	return str_quickhash(pName) ^ ((unsigned)ColorID*2654435761u);
+}
+
+void CPlayerDataStore::Clear()
+{
+	for(int i = 0; i < m_HashSize; i++)
 	{
-		if (m_pChild1)
-			return m_pChild1->Get(pName, ColorID);
-		else
-			return 0;
+		CPlayerData *pData = m_apHash[i];
+		while(pData)
+		{
+			CPlayerData *pNext = pData->m_pNext;
+			delete pData;
+			pData = pNext;
+		}
 	}
-	else
+
+	if(m_apHash)
+		mem_free(m_apHash);
+	m_apHash = 0;
+	m_HashSize = 0;
+	m_NumPlayers = 0;
+	m_HighScore = 0;
+}
+
+void CPlayerDataStore::Grow()
+{
+	int NewSize = max(m_HashSize*2, (int)MIN_HASH_SIZE);
+	CPlayerData **apNewHash = (CPlayerData **)mem_alloc(sizeof(CPlayerData *)*NewSize, 1);
+	mem_zero(apNewHash, sizeof(CPlayerData *)*NewSize);
+
+	for(int i = 0; i < m_HashSize; i++)
 	{
-		if (m_pChild2)
-			return m_pChild2->Get(pName, ColorID);
-		else
-			return 0;
+		CPlayerData *pData = m_apHash[i];
+		while(pData)
+		{
+			CPlayerData *pNext = pData->m_pNext;
+			int Bucket = pData->m_Hash&(NewSize-1);
+			pData->m_pNext = apNewHash[Bucket];
+			apNewHash[Bucket] = pData;
+			pData = pNext;
+		}
 	}
-	
+
+	if(m_apHash)
+		mem_free(m_apHash);
+	m_apHash = apNewHash;
+	m_HashSize = NewSize;
+}
+
+void CPlayerDataStore::Insert(CPlayerData *pData)
+{
+	if(m_NumPlayers >= m_HashSize)
+		Grow();
+
+	pData->m_Hash = Hash(pData->m_aName, pData->m_ColorID);
+	int Bucket = pData->m_Hash&(m_HashSize-1);
+	pData->m_pNext = m_apHash[Bucket];
+	m_apHash[Bucket] = pData;
+	m_NumPlayers++;
+}
+
+CPlayerData *CPlayerDataStore::Find(const char *pName, int ColorID)
+{
+	if(!m_HashSize)
+		return 0;
+
+	unsigned h = Hash(pName, ColorID);
+	for(CPlayerData *pData = m_apHash[h&(m_HashSize-1)]; pData; pData = pData->m_pNext)
+	{
+		if(pData->m_Hash == h && pData->m_ColorID == ColorID && str_comp(pData->m_aName, pName) == 0)
+			return pData;
+	}
+
 	return 0;
 }
 
+CPlayerData *CPlayerDataStore::Get(const char *pName, int ColorID)
+{
+	CPlayerData *pData = Find(pName, ColorID);
+	if(pData)
+		return pData;
+
+	pData = new CPlayerData(pName, ColorID);
+	Insert(pData);
+	return pData;
+}
+
+void CPlayerDataStore::UpdateHighScore(CPlayerData *pData)
+{
+	if(pData->m_HighestLevel >= m_HighScore)
+		m_HighScore = pData->m_HighestLevel;
+	else if(pData->m_SavedLevel == m_HighScore)
+	{
+		// the best record went down, look for the new one
+		m_HighScore = 0;
+		for(int i = 0; i < m_HashSize; i++)
+			for(CPlayerData *p = m_apHash[i]; p; p = p->m_pNext)
+				m_HighScore = max(m_HighScore, p == pData ? pData->m_HighestLevel : p->m_SavedLevel);
+	}
+
+	pData->m_SavedLevel = pData->m_HighestLevel;
+}
+
+bool CPlayerDataStore::WriteRecord(IOHANDLE File, const CPlayerData *pData, int *pSize)
+{
+	CPacker Packer;
+	Packer.Reset();
+	Packer.AddString(pData->m_aName, sizeof(pData->m_aName));
+	Packer.AddInt(pData->m_ColorID);
+	pData->Pack(&Packer);
+	if(Packer.Error() || Packer.Size() > MAX_RECORD_SIZE)
+	{
+		dbg_msg("playerdata", "record of '%s' is too big", pData->m_aName);
+		return true;
+	}
+
+	// size, data, checksum
+	unsigned char aSize[4];
+	unsigned char aChecksum[4];
+	WriteUInt(aSize, Packer.Size());
+	WriteUInt(aChecksum, RecordChecksum(Packer.Data(), Packer.Size()));
+	if(io_write(File, aSize, sizeof(aSize)) != sizeof(aSize) ||
+		io_write(File, Packer.Data(), Packer.Size()) != (unsigned)Packer.Size() ||
+		io_write(File, aChecksum, sizeof(aChecksum)) != sizeof(aChecksum))
+		return false;
+
+	if(pSize)
+		*pSize += sizeof(aSize) + Packer.Size() + sizeof(aChecksum);
+	return true;
+}
 
-int CPlayerData::GetHighScore(int Score)
+int CPlayerDataStore::LoadFile(const char *pFilename, int HeaderSize)
 {
-	int s = max(m_HighestLevel, Score);
+	IOHANDLE File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return -1;
+
+	int Size = (int)io_length(File);
+	unsigned char *pFileData = (unsigned char *)mem_alloc(max(Size, 1), 1);
+	Size = io_read(File, pFileData, Size);
+	io_close(File);
+
+	if(HeaderSize && (Size < HeaderSize || mem_comp(pFileData, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+		ReadUInt(pFileData+sizeof(SNAPSHOT_MAGIC)) != VERSION))
+	{
+		dbg_msg("playerdata", "'%s' is not a player data file", pFilename);
+		mem_free(pFileData);
+		return 0;
+	}
+
+	// a crash can leave a partial record at the end, stop there
+	int Offset = HeaderSize;
+	int NumRecords = 0;
+	while(Offset + 8 <= Size)
+	{
+		int RecordSize = ReadUInt(pFileData+Offset);
+		if(RecordSize <= 0 || RecordSize > MAX_RECORD_SIZE || Offset+8+RecordSize > Size)
+			break;
+
+		const unsigned char *pRecord = pFileData+Offset+4;
+		if(RecordChecksum(pRecord, RecordSize) != ReadUInt(pRecord+RecordSize))
+			break;
 
-	if (m_pChild1)
-		s = max(s, m_pChild1->GetHighScore(s));
+		CUnpacker Unpacker;
+		Unpacker.Reset(pRecord, RecordSize);
+		const char *pName = Unpacker.GetString();
+		int ColorID = Unpacker.GetInt();
+		if(Unpacker.Error())
+			break;
 
-	if (m_pChild2)
-		s = max(s, m_pChild2->GetHighScore(s));
+		CPlayerData *pData = Get(pName, ColorID);
+		if(!pData->Unpack(&Unpacker))
+			break;
+		UpdateHighScore(pData);
 
-	return s;
+		Offset += 8+RecordSize;
+		NumRecords++;
+	}
+
+	if(Offset < Size)
+		dbg_msg("playerdata", "'%s' is damaged, dropped %d bytes after %d records", pFilename, Size-Offset, NumRecords);
+
+	mem_free(pFileData);
+	return NumRecords;
 }
 
-int CPlayerData::GetPlayerCount(int Score)
+bool CPlayerDataStore::WriteFile(const char *pFilename, const char *pBackupFile, bool Header, int *pSize)
 {
+	// write to a temporary file first, the old file stays valid until the rename
+	char aTmpFile[256];
+	str_format(aTmpFile, sizeof(aTmpFile), "%s.tmp", pFilename);
+	IOHANDLE File = m_pStorage->OpenFile(aTmpFile, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		dbg_msg("playerdata", "can't write '%s'", aTmpFile);
+		return false;
+	}
 
-	if (m_pChild1)
-		Score += m_pChild1->GetPlayerCount(0);
+	bool Error = false;
+	if(Header)
+	{
+		unsigned char aHeader[8];
+		mem_copy(aHeader, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+		WriteUInt(aHeader+sizeof(SNAPSHOT_MAGIC), VERSION);
+		Error = io_write(File, aHeader, sizeof(aHeader)) != sizeof(aHeader);
+	}
+
+	for(int i = 0; i < m_HashSize && !Error; i++)
+		for(CPlayerData *pData = m_apHash[i]; pData && !Error; pData = pData->m_pNext)
+			Error = !WriteRecord(File, pData, pSize);
 
-	if (m_pChild2)
-		Score += m_pChild2->GetPlayerCount(0);
+	if(io_close(File) != 0 || Error)
+	{
+		dbg_msg("playerdata", "can't write '%s'", aTmpFile);
+		m_pStorage->RemoveFile(aTmpFile, IStorage::TYPE_SAVE);
+		return false;
+	}
 
-	return Score+1;
+	// rename replaces the old file in one step, there is always a complete one on disk
+	if(m_pStorage->RenameFile(aTmpFile, pFilename, IStorage::TYPE_SAVE))
+		return true;
+
+	// rename can't replace files on every platform, keep the old file as backup meanwhile
+	m_pStorage->RemoveFile(pBackupFile, IStorage::TYPE_SAVE);
+	if(!m_pStorage->RenameFile(pFilename, pBackupFile, IStorage::TYPE_SAVE) ||
+		!m_pStorage->RenameFile(aTmpFile, pFilename, IStorage::TYPE_SAVE))
+	{
+		dbg_msg("playerdata", "can't replace '%s'", pFilename);
+		return false;
+	}
+	m_pStorage->RemoveFile(pBackupFile, IStorage::TYPE_SAVE);
+
+	return true;
 }
 
+bool CPlayerDataStore::WriteSnapshot()
+{
+	return WriteFile(m_aSnapshotFile, m_aBackupFile, true, 0);
+}
 
-void CPlayerData::Reset()
+void CPlayerDataStore::OpenJournal(bool Append)
 {
-	for (int i = 0; i < 99; i++)
+	if(m_Journal)
+		io_close(m_Journal);
+
+	// unless appending, everything in the old journal is in the snapshot by now
+	m_Journal = m_pStorage->OpenFile(m_aJournalFile, Append ? IOFLAG_APPEND : IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	m_JournalSize = 0;
+	if(!m_Journal)
+		dbg_msg("playerdata", "can't open '%s', player data won't be saved", m_aJournalFile);
+	else if(!Append)
+		m_pStorage->RemoveFile(m_aJournalBackupFile, IStorage::TYPE_SAVE);
+}
+
+void CPlayerDataStore::Init(IStorage *pStorage, const char *pName)
+{
+	Shutdown();
+
+	m_pStorage = pStorage;
+	str_format(m_aSnapshotFile, sizeof(m_aSnapshotFile), "%s.dat", pName);
+	str_format(m_aBackupFile, sizeof(m_aBackupFile), "%s.dat.bak", pName);
+	str_format(m_aJournalFile, sizeof(m_aJournalFile), "%s.journal", pName);
+	str_format(m_aJournalBackupFile, sizeof(m_aJournalBackupFile), "%s.journal.bak", pName);
+
+	// the backups only exist alone if replacing a file got interrupted
+	int NumSnapshot = LoadFile(m_aSnapshotFile, 8);
+	if(NumSnapshot < 0)
+		NumSnapshot = LoadFile(m_aBackupFile, 8);
+	int NumJournal = LoadFile(m_aJournalFile, 0);
+	if(NumJournal < 0)
+		NumJournal = LoadFile(m_aJournalBackupFile, 0);
+
+	if(NumJournal > 0 && !WriteSnapshot())
 	{
-		m_aWeaponType[i] = 0;
-		m_aWeaponAmmo[i] = 0;
-		
-		m_aAmmo[i] = -1;
+		// the journal is the only copy of these records. rewrite it with everything
+		// loaded and keep appending, a damaged tail would hide appended records
+		int Size = 0;
+		if(WriteFile(m_aJournalFile, m_aJournalBackupFile, false, &Size))
+		{
+			OpenJournal(true);
+			m_JournalSize = Size;
+		}
+		else
+			dbg_msg("playerdata", "player data won't be saved");
 	}
-	
-	m_Armor = 0;
-	m_Weapon = 0;
-	m_Kits = 0;
-	m_Score = 0;
-	m_Gold = 0;
-	m_HighestLevel = 0;
-	m_HighestLevelSeed = 0;
-}
\ No newline at end of file
+	else
+		OpenJournal(false);
+
+	dbg_msg("playerdata", "loaded %d players (%d snapshot, %d journal records)", m_NumPlayers, max(NumSnapshot, 0), max(NumJournal, 0));
+}
+
+void CPlayerDataStore::Shutdown()
+{
+	if(m_Journal)
+	{
+		io_close(m_Journal);
+		m_Journal = 0;
+
+		if(m_JournalSize > 0 && WriteSnapshot())
+			m_pStorage->RemoveFile(m_aJournalFile, IStorage::TYPE_SAVE);
+	}
+
+	Clear();
+}
+
+bool CPlayerDataStore::Save(CPlayerData *pData)
+{
+	UpdateHighScore(pData);
+
+	if(m_Journal && WriteRecord(m_Journal, pData, &m_JournalSize) && io_flush(m_Journal) == 0)
+	{
+		// fold the journal into the snapshot before it gets too long to replay
+		if(m_JournalSize > MAX_JOURNAL_SIZE && WriteSnapshot())
+			OpenJournal(false);
+		return true;
+	}
+
+	// a failed write can leave a partial record, nothing appended after it would be read back.
+	// the record is in memory, a new snapshot still gets it to disk
+	if(m_Journal)
+	{
+		io_close(m_Journal);
+		m_Journal = 0;
+	}
+	if(WriteSnapshot())
+	{
+		OpenJournal(false);
+		return true;
+	}
+
+	dbg_msg("playerdata", "can't save '%s'", pData->m_aName);
+	return false;
+}
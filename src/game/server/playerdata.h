@@ -1,40 +1,110 @@
 #ifndef GAME_SERVER_PLAYERDATA_H
 #define GAME_SERVER_PLAYERDATA_H
 
+#include <base/system.h>
+
 // stored player data for switching between levels
 class CPlayerData
 {
-private:
-	CPlayerData *m_pChild1;
-	CPlayerData *m_pChild2;
+	friend class CPlayerDataStore;
+
+	// hash chain of the store
+	CPlayerData *m_pNext;
+	unsigned m_Hash;
+
+	// highest level as of the last save, keeps the store's high score right
+	int m_SavedLevel;
 
 public:
+	enum
+	{
+		NUM_SLOTS=99,
+	};
+
 	CPlayerData(const char *pName, int ColorID);
 	void Die();
 	void Reset();
-	
-	int m_aWeaponType[99];
-	int m_aWeaponAmmo[99];
-	
-	int m_aAmmo[99];
+
+	int m_aWeaponType[NUM_SLOTS];
+	int m_aWeaponAmmo[NUM_SLOTS];
+
+	int m_aAmmo[NUM_SLOTS];
 	int m_Weapon;
 	int m_Armor;
 	int m_Kits;
 	int m_Score;
 	int m_Gold;
-	
+
 	int m_HighestLevel;
 	int m_HighestLevelSeed;
-	
+
 	int m_ColorID;
-	
+
 	char m_aName[16];
-	
-	void Add(CPlayerData *pPlayerData);
+
+	// only the slots that differ from Reset() are written
+	void Pack(class CPacker *pPacker) const;
+	bool Unpack(class CUnpacker *pUnpacker);
+};
+
+/*
+	All the player data of the server, hashed by name and color. The
+	records are kept in a snapshot file plus a journal that gets every
+	saved record appended, the journal is folded into the snapshot when
+	the store is opened, closed or the journal grows too big.
+*/
+class CPlayerDataStore
+{
+	enum
+	{
+		MIN_HASH_SIZE=64,
+		MAX_RECORD_SIZE=2048,
+		MAX_JOURNAL_SIZE=1024*1024,
+		VERSION=1,
+	};
+
+	CPlayerData **m_apHash;
+	int m_HashSize;
+	int m_NumPlayers;
+	int m_HighScore;
+
+	class IStorage *m_pStorage;
+	char m_aSnapshotFile[128];
+	char m_aBackupFile[128];
+	char m_aJournalFile[128];
+	char m_aJournalBackupFile[128];
+	IOHANDLE m_Journal;
+	int m_JournalSize;
+
+	static unsigned Hash(const char *pName, int ColorID);
+	void Insert(CPlayerData *pData);
+	void Grow();
+	void UpdateHighScore(CPlayerData *pData);
+
+	// returns the number of records read, -1 if the file is missing
+	int LoadFile(const char *pFilename, int HeaderSize);
+	// writes all records through a temporary file, pBackupFile holds the old file while it gets replaced
+	bool WriteFile(const char *pFilename, const char *pBackupFile, bool Header, int *pSize);
+	bool WriteSnapshot();
+	void OpenJournal(bool Append);
+	bool WriteRecord(IOHANDLE File, const CPlayerData *pData, int *pSize);
+
+public:
+	CPlayerDataStore();
+	~CPlayerDataStore();
+
+	void Init(class IStorage *pStorage, const char *pName);
+	void Shutdown();
+	void Clear();
+
+	CPlayerData *Find(const char *pName, int ColorID);
+	// creates the record if it doesn't exist yet
 	CPlayerData *Get(const char *pName, int ColorID);
-	
-	int GetHighScore(int Score);
-	int GetPlayerCount(int Score);
+	// journals the record, call after changing it. false if it couldn't be written
+	bool Save(CPlayerData *pData);
+
+	int GetHighScore() const { return m_HighScore; }
+	int GetPlayerCount() const { return m_NumPlayers; }
 };
 
 #endif
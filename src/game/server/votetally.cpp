@@ -0,0 +1,128 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include "votetally.h"
+
+CVoteTally::CVoteTally()
+{
+	Reset();
+}
+
+void CVoteTally::Reset()
+{
+	mem_zero(m_aClients, sizeof(m_aClients));
+	for(int i = 0; i < NUM_BUCKETS; i++)
+		m_aBuckets[i] = -1;
+	m_Total = 0;
+	m_Yes = 0;
+	m_No = 0;
+}
+
+void CVoteTally::CountAddr(const char *pAddr, unsigned Hash, int Sign)
+{
+	// the lowest non-spectator decides if the address counts, the first
+	// vote from there on is the vote of the address
+	int First = -1;
+	for(int i = m_aBuckets[Hash%NUM_BUCKETS]; i >= 0; i = m_aClients[i].m_Next)
+	{
+		if(m_aClients[i].m_Counted && m_aClients[i].m_Hash == Hash && (First < 0 || i < First) && str_comp(m_aClients[i].m_aAddr, pAddr) == 0)
+			First = i;
+	}
+	if(First < 0)
+		return;
+
+	int Vote = 0;
+	int VotePos = 0;
+	for(int i = m_aBuckets[Hash%NUM_BUCKETS]; i >= 0; i = m_aClients[i].m_Next)
+	{
+		const CClient *pClient = &m_aClients[i];
+		if(i < First || !pClient->m_Vote || pClient->m_Hash != Hash || str_comp(pClient->m_aAddr, pAddr) != 0)
+			continue;
+		if(!Vote || pClient->m_VotePos < VotePos)
+		{
+			Vote = pClient->m_Vote;
+			VotePos = pClient->m_VotePos;
+		}
+	}
+
+	m_Total += Sign;
+	if(Vote > 0)
+		m_Yes += Sign;
+	else if(Vote < 0)
+		m_No += Sign;
+}
+
+void CVoteTally::Link(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	int b = pClient->m_Hash%NUM_BUCKETS;
+	pClient->m_Next = m_aBuckets[b];
+	m_aBuckets[b] = ClientID;
+}
+
+void CVoteTally::Unlink(int ClientID)
+{
+	int *pLink = &m_aBuckets[m_aClients[ClientID].m_Hash%NUM_BUCKETS];
+	while(*pLink >= 0)
+	{
+		if(*pLink == ClientID)
+		{
+			*pLink = m_aClients[ClientID].m_Next;
+			break;
+		}
+		pLink = &m_aClients[*pLink].m_Next;
+	}
+}
+
+void CVoteTally::SetClient(int ClientID, const char *pAddr, bool Counted)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	int Vote = pClient->m_Active ? pClient->m_Vote : 0;
+	int VotePos = pClient->m_Active ? pClient->m_VotePos : 0;
+	RemoveClient(ClientID);
+
+	unsigned Hash = str_quickhash(pAddr);
+	CountAddr(pAddr, Hash, -1);
+	pClient->m_Active = true;
+	pClient->m_Counted = Counted;
+	pClient->m_Vote = Vote;
+	pClient->m_VotePos = VotePos;
+	pClient->m_Hash = Hash;
+	str_copy(pClient->m_aAddr, pAddr, sizeof(pClient->m_aAddr));
+	Link(ClientID);
+	CountAddr(pAddr, Hash, 1);
+}
+
+void CVoteTally::RemoveClient(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	if(!pClient->m_Active)
+		return;
+
+	CountAddr(pClient->m_aAddr, pClient->m_Hash, -1);
+	Unlink(ClientID);
+	pClient->m_Active = false;
+	CountAddr(pClient->m_aAddr, pClient->m_Hash, 1);
+}
+
+void CVoteTally::SetVote(int ClientID, int Vote, int VotePos)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	if(!pClient->m_Active)
+		return;
+
+	CountAddr(pClient->m_aAddr, pClient->m_Hash, -1);
+	pClient->m_Vote = Vote;
+	pClient->m_VotePos = VotePos;
+	CountAddr(pClient->m_aAddr, pClient->m_Hash, 1);
+}
+
+void CVoteTally::ClearVotes()
+{
+	m_Yes = 0;
+	m_No = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_aClients[i].m_Vote = 0;
+		m_aClients[i].m_VotePos = 0;
+	}
+}
@@ -0,0 +1,59 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_SERVER_VOTETALLY_H
+#define GAME_SERVER_VOTETALLY_H
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+
+/*
+	Vote counts of the running vote. Clients with the same address count
+	once, with the vote of the one who voted first. Clients are hashed by
+	address and every change only recounts the clients sharing the
+	address of the one that changed.
+*/
+class CVoteTally
+{
+	enum
+	{
+		NUM_BUCKETS=128,
+	};
+
+	struct CClient
+	{
+		bool m_Active;
+		bool m_Counted; // not a spectator
+		int m_Vote;
+		int m_VotePos;
+		unsigned m_Hash;
+		int m_Next;
+		char m_aAddr[NETADDR_MAXSTRSIZE];
+	};
+
+	CClient m_aClients[MAX_CLIENTS];
+	int m_aBuckets[NUM_BUCKETS];
+
+	int m_Total;
+	int m_Yes;
+	int m_No;
+
+	// adds (Sign=1) or removes (Sign=-1) the counts of the clients using the address
+	void CountAddr(const char *pAddr, unsigned Hash, int Sign);
+	void Link(int ClientID);
+	void Unlink(int ClientID);
+
+public:
+	CVoteTally();
+
+	void Reset();
+	void SetClient(int ClientID, const char *pAddr, bool Counted);
+	void RemoveClient(int ClientID);
+	void SetVote(int ClientID, int Vote, int VotePos);
+	void ClearVotes();
+
+	int Total() const { return m_Total; }
+	int Yes() const { return m_Yes; }
+	int No() const { return m_No; }
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef GAME_WEAPONPROPS_H
+#define GAME_WEAPONPROPS_H
+#undef GAME_WEAPONPROPS_H // this file will be included several times
+
+// the tabled weapon properties, see GetWeaponProperties
+// type, field, lookup function
+MACRO_WEAPON_PROPERTY(bool, ValidForTurret, ValidForTurret)
+MACRO_WEAPON_PROPERTY(int, WeaponCost, GetWeaponCost)
+MACRO_WEAPON_PROPERTY(int, ProjectileTraceType, GetProjectileTraceType)
+MACRO_WEAPON_PROPERTY(float, WeaponTraceThreshold, GetWeaponTraceThreshold)
+MACRO_WEAPON_PROPERTY(bool, AIWeaponCharge, AIWeaponCharge)
+MACRO_WEAPON_PROPERTY(float, WeaponLevelCharge, GetWeaponLevelCharge)
+MACRO_WEAPON_PROPERTY(vec2, WeaponColorswap, GetWeaponColorswap)
+MACRO_WEAPON_PROPERTY(float, ProjectileSize, GetProjectileSize)
+MACRO_WEAPON_PROPERTY(int, ExplosionSprite, GetExplosionSprite)
+MACRO_WEAPON_PROPERTY(int, ExplosionSound, GetExplosionSound)
+MACRO_WEAPON_PROPERTY(int, WeaponFireSound, GetWeaponFireSound)
+MACRO_WEAPON_PROPERTY(int, WeaponFireSound2, GetWeaponFireSound2)
+MACRO_WEAPON_PROPERTY(float, ExplosionSize, GetExplosionSize)
+MACRO_WEAPON_PROPERTY(float, ExplosionDamage, GetExplosionDamage)
+MACRO_WEAPON_PROPERTY(int, WeaponRenderType, GetWeaponRenderType)
+MACRO_WEAPON_PROPERTY(ivec2, WeaponVisualSize, GetWeaponVisualSize)
+MACRO_WEAPON_PROPERTY(ivec2, WeaponVisualSize2, GetWeaponVisualSize2)
+MACRO_WEAPON_PROPERTY(int, WeaponFiringType, GetWeaponFiringType)
+MACRO_WEAPON_PROPERTY(float, WeaponRenderRecoil, GetWeaponRenderRecoil)
+MACRO_WEAPON_PROPERTY(vec2, WeaponRenderOffset, GetWeaponRenderOffset)
+MACRO_WEAPON_PROPERTY(vec2, MuzzleRenderOffset, GetMuzzleRenderOffset)
+MACRO_WEAPON_PROPERTY(int, WeaponProjectilePosType, WeaponProjectilePosType)
+MACRO_WEAPON_PROPERTY(vec2, ProjectileOffset, GetProjectileOffset)
+MACRO_WEAPON_PROPERTY(vec2, HandOffset, GetHandOffset)
+MACRO_WEAPON_PROPERTY(float, ScreenshakeAmount, ScreenshakeAmount)
+MACRO_WEAPON_PROPERTY(float, MeleeHitRadius, GetMeleeHitRadius)
+MACRO_WEAPON_PROPERTY(bool, WeaponAimline, WeaponAimline)
+MACRO_WEAPON_PROPERTY(bool, IsLaserWeapon, IsLaserWeapon)
+MACRO_WEAPON_PROPERTY(int, WeaponMaxLevel, WeaponMaxLevel)
+MACRO_WEAPON_PROPERTY(int, LaserCharge, GetLaserCharge)
+MACRO_WEAPON_PROPERTY(int, LaserRange, GetLaserRange)
+MACRO_WEAPON_PROPERTY(int, MuzzleType, GetMuzzleType)
+MACRO_WEAPON_PROPERTY(int, MuzzleAmount, GetMuzzleAmount)
+MACRO_WEAPON_PROPERTY(float, ProjectileSpeed, GetProjectileSpeed)
+MACRO_WEAPON_PROPERTY(float, ProjectileCurvature, GetProjectileCurvature)
+MACRO_WEAPON_PROPERTY(int, ShotSpread, GetShotSpread)
+MACRO_WEAPON_PROPERTY(float, ProjectileSpread, GetProjectileSpread)
+MACRO_WEAPON_PROPERTY(bool, IsFlammableProjectile, IsFlammableProjectile)
+MACRO_WEAPON_PROPERTY(float, WeaponFlameAmount, WeaponFlameAmount)
+MACRO_WEAPON_PROPERTY(int, AIAttackRange, AIAttackRange)
+MACRO_WEAPON_PROPERTY(float, WeaponElectroAmount, WeaponElectroAmount)
+MACRO_WEAPON_PROPERTY(int, WeaponBurstCount, WeaponBurstCount)
+MACRO_WEAPON_PROPERTY(float, WeaponBurstReload, WeaponBurstReload)
+MACRO_WEAPON_PROPERTY(float, ProjectileDamage, GetProjectileDamage)
+MACRO_WEAPON_PROPERTY(bool, WeaponAutoPick, WeaponAutoPick)
+MACRO_WEAPON_PROPERTY(float, ProjectileKnockback, GetProjectileKnockback)
+MACRO_WEAPON_PROPERTY(float, WeaponThrowForce, WeaponThrowForce)
+MACRO_WEAPON_PROPERTY(float, WeaponFireRate, GetWeaponFireRate)
+MACRO_WEAPON_PROPERTY(float, WeaponKnockback, GetWeaponKnockback)
+MACRO_WEAPON_PROPERTY(bool, WeaponFullAuto, GetWeaponFullAuto)
+MACRO_WEAPON_PROPERTY(int, IsProjectileBouncy, IsProjectileBouncy)
+MACRO_WEAPON_PROPERTY(bool, IsExplosiveProjectile, IsExplosiveProjectile)
+MACRO_WEAPON_PROPERTY(int, WeaponMaxAmmo, GetWeaponMaxAmmo)
+MACRO_WEAPON_PROPERTY(bool, WeaponUseAmmo, WeaponUseAmmo)
+
+#endif
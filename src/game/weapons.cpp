@@ -1,3 +1,4 @@
+#include <base/system.h>
 #include <engine/shared/config.h>
 #include <engine/shared/protocol.h>
 #include <game/server/Core/GameEntities/droid.h>
@@ -5,7 +6,7 @@
 
 #include "weapons.h"
 
-const bool ValidForTurret(int Weapon)
+static const bool CalcValidForTurret(int Weapon)
 {
 	if (IsModularWeapon(Weapon) && GetWeaponFiringType(Weapon) == WFT_PROJECTILE)
 		return true;
@@ -16,7 +17,7 @@ const bool ValidForTurret(int Weapon)
 	return false;
 }
 
-const int GetWeaponCost(int Weapon)
+static const int CalcWeaponCost(int Weapon)
 {
 	const float Charge = GetWeaponLevelCharge(Weapon);
 
@@ -84,7 +85,7 @@ const int GetWeaponCost(int Weapon)
 	return cost1 + cost2 * Charge * (Charge * 0.25f + 0.75f);
 }
 
-const int GetProjectileTraceType(int Weapon)
+static const int CalcProjectileTraceType(int Weapon)
 {
 
 	if (IsDroid(Weapon))
@@ -141,7 +142,7 @@ const int GetProjectileTraceType(int Weapon)
 	return 1;
 }
 
-const float GetWeaponTraceThreshold(int Weapon)
+static const float CalcWeaponTraceThreshold(int Weapon)
 {
 	if (IsStaticWeapon(Weapon))
 	{
@@ -163,7 +164,7 @@ const float GetWeaponTraceThreshold(int Weapon)
 	return 0.0f;
 }
 
-const bool AIWeaponCharge(int Weapon)
+static const bool CalcAIWeaponCharge(int Weapon)
 {
 	if (GetWeaponFiringType(Weapon) == WFT_THROW || GetWeaponFiringType(Weapon) == WFT_CHARGE)
 		return true;
@@ -171,12 +172,12 @@ const bool AIWeaponCharge(int Weapon)
 	return false;
 }
 
-const float GetWeaponLevelCharge(int Weapon)
+static const float CalcWeaponLevelCharge(int Weapon)
 {
 	return GetWeaponCharge(Weapon) / float(std::max(1, WeaponMaxLevel(Weapon)));
 }
 
-const vec2 GetWeaponColorswap(int Weapon)
+static const vec2 CalcWeaponColorswap(int Weapon)
 {
 	const float Charge = GetWeaponLevelCharge(Weapon);
 
@@ -219,7 +220,7 @@ const vec2 GetWeaponColorswap(int Weapon)
 	return vec2(0, 0);
 }
 
-const float GetProjectileSize(int Weapon)
+static const float CalcProjectileSize(int Weapon)
 {
 	if (IsDroid(Weapon))
 	{
@@ -314,7 +315,7 @@ const float GetProjectileSize(int Weapon)
 	return Size;
 }
 
-const int GetExplosionSprite(int Weapon)
+static const int CalcExplosionSprite(int Weapon)
 {
 	if (IsBuilding(Weapon))
 	{
@@ -372,7 +373,7 @@ const int GetExplosionSprite(int Weapon)
 	return 0;
 }
 
-const int GetExplosionSound(int Weapon)
+static const int CalcExplosionSound(int Weapon)
 {
 	if (IsBuilding(Weapon))
 	{
@@ -438,7 +439,7 @@ const int GetExplosionSound(int Weapon)
 	return 0;
 }
 
-const int GetWeaponFireSound(int Weapon)
+static const int CalcWeaponFireSound(int Weapon)
 {
 	if (IsStaticWeapon(Weapon))
 	{
@@ -491,7 +492,7 @@ const int GetWeaponFireSound(int Weapon)
 	return -1;
 }
 
-const int GetWeaponFireSound2(int Weapon)
+static const int CalcWeaponFireSound2(int Weapon)
 {
 	if (!IsModularWeapon(Weapon))
 		return -1;
@@ -510,7 +511,7 @@ const int GetWeaponFireSound2(int Weapon)
 	return -1;
 }
 
-const float GetExplosionSize(int Weapon)
+static const float CalcExplosionSize(int Weapon)
 {
 	if (IsBuilding(Weapon))
 	{
@@ -587,7 +588,7 @@ const float GetExplosionSize(int Weapon)
 	return Size;
 }
 
-const float GetExplosionDamage(int Weapon)
+static const float CalcExplosionDamage(int Weapon)
 {
 	if (IsBuilding(Weapon))
 	{
@@ -668,7 +669,7 @@ const float GetExplosionDamage(int Weapon)
 	return Size;
 }
 
-const int GetWeaponRenderType(int Weapon)
+static const int CalcWeaponRenderType(int Weapon)
 {
 	if (Weapon == WEAPON_NONE)
 		return WRT_NONE;
@@ -709,7 +710,7 @@ const int GetWeaponRenderType(int Weapon)
 	};
 }
 
-const ivec2 GetWeaponVisualSize(int Weapon)
+static const ivec2 CalcWeaponVisualSize(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -776,7 +777,7 @@ const ivec2 GetWeaponVisualSize(int Weapon)
 	return ivec2(0, 0);
 }
 
-const ivec2 GetWeaponVisualSize2(int Weapon)
+static const ivec2 CalcWeaponVisualSize2(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -796,7 +797,7 @@ const ivec2 GetWeaponVisualSize2(int Weapon)
 	return ivec2(0, 0);
 }
 
-const int GetWeaponFiringType(int Weapon)
+static const int CalcWeaponFiringType(int Weapon)
 {
 	if (Weapon == WEAPON_NONE)
 		return WFT_NONE;
@@ -861,7 +862,7 @@ const int GetWeaponFiringType(int Weapon)
 	return WFT_NONE;
 }
 
-const float GetWeaponRenderRecoil(int Weapon)
+static const float CalcWeaponRenderRecoil(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -903,7 +904,7 @@ const float GetWeaponRenderRecoil(int Weapon)
 	return 0.0f;
 }
 
-const vec2 GetWeaponRenderOffset(int Weapon)
+static const vec2 CalcWeaponRenderOffset(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -973,7 +974,7 @@ const vec2 GetWeaponRenderOffset(int Weapon)
 	return vec2(0, 0);
 }
 
-const vec2 GetMuzzleRenderOffset(int Weapon)
+static const vec2 CalcMuzzleRenderOffset(int Weapon)
 {
 	if (GetStaticType(Weapon) == SW_GUN1)
 		return vec2(20, -5);
@@ -1007,7 +1008,7 @@ const vec2 GetMuzzleRenderOffset(int Weapon)
 	return vec2(0, 0);
 }
 
-const int WeaponProjectilePosType(int Weapon)
+static const int CalcWeaponProjectilePosType(int Weapon)
 {
 	if (IsDroid(Weapon))
 	{
@@ -1031,7 +1032,7 @@ const int WeaponProjectilePosType(int Weapon)
 	return 0;
 }
 
-const vec2 GetProjectileOffset(int Weapon)
+static const vec2 CalcProjectileOffset(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -1089,7 +1090,7 @@ const vec2 GetProjectileOffset(int Weapon)
 	return vec2(0, 0);
 }
 
-const vec2 GetHandOffset(int Weapon)
+static const vec2 CalcHandOffset(int Weapon)
 {
 	if (IsStaticWeapon(Weapon))
 	{
@@ -1105,7 +1106,7 @@ const vec2 GetHandOffset(int Weapon)
 	return vec2(-26, 8);
 }
 
-const float ScreenshakeAmount(int Weapon)
+static const float CalcScreenshakeAmount(int Weapon)
 {
 	float d = GetExplosionDamage(Weapon) * 0.2f;
 
@@ -1115,7 +1116,7 @@ const float ScreenshakeAmount(int Weapon)
 	return 0.0f;
 }
 
-const float GetMeleeHitRadius(int Weapon)
+static const float CalcMeleeHitRadius(int Weapon)
 {
 	const float Charge = GetWeaponLevelCharge(Weapon);
 
@@ -1173,7 +1174,7 @@ const float GetMeleeHitRadius(int Weapon)
 	return 0.0f;
 }
 
-const bool WeaponAimline(int Weapon)
+static const bool CalcWeaponAimline(int Weapon)
 {
 	if (IsModularWeapon(Weapon) && (GetPart(Weapon, GROUP_PART1) == SW_GRENADE2 || GetPart(Weapon, GROUP_PART2) == SW_GRENADE1))
 		return true;
@@ -1181,7 +1182,7 @@ const bool WeaponAimline(int Weapon)
 	return false;
 }
 
-const bool IsLaserWeapon(int Weapon)
+static const bool CalcIsLaserWeapon(int Weapon)
 {
 	if (IsModularWeapon(Weapon) && GetPart(Weapon, GROUP_PART1) == SW_GRENADE1 && (GetPart(Weapon, GROUP_PART2) == SW_GUN2 || GetPart(Weapon, GROUP_PART2) == SW_GRENADE1))
 		return true;
@@ -1189,7 +1190,7 @@ const bool IsLaserWeapon(int Weapon)
 	return false;
 }
 
-const int WeaponMaxLevel(int Weapon)
+static const int CalcWeaponMaxLevel(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 		return 4;
@@ -1218,7 +1219,7 @@ const int WeaponMaxLevel(int Weapon)
 	return 0;
 }
 
-const int GetLaserCharge(int Weapon)
+static const int CalcLaserCharge(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -1236,7 +1237,7 @@ const int GetLaserCharge(int Weapon)
 	return 0;
 }
 
-const int GetLaserRange(int Weapon)
+static const int CalcLaserRange(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -1252,7 +1253,7 @@ const int GetLaserRange(int Weapon)
 	return 0;
 }
 
-const int GetMuzzleType(int Weapon)
+static const int CalcMuzzleType(int Weapon)
 {
 	if (GetStaticType(Weapon) == SW_GUN2)
 		return 1;
@@ -1275,7 +1276,7 @@ const int GetMuzzleType(int Weapon)
 	return 0;
 }
 
-const int GetMuzzleAmount(int Weapon)
+static const int CalcMuzzleAmount(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -1291,7 +1292,7 @@ const int GetMuzzleAmount(int Weapon)
 	return 10;
 }
 
-const float GetProjectileSpeed(int Weapon)
+static const float CalcProjectileSpeed(int Weapon)
 {
 	if (IsDroid(Weapon))
 	{
@@ -1381,7 +1382,7 @@ const float GetProjectileSpeed(int Weapon)
 	return Speed;
 }
 
-const float GetProjectileCurvature(int Weapon)
+static const float CalcProjectileCurvature(int Weapon)
 {
 	if (IsDroid(Weapon))
 	{
@@ -1474,7 +1475,7 @@ const float GetProjectileCurvature(int Weapon)
 	return Curvature;
 }
 
-const int GetShotSpread(int Weapon)
+static const int CalcShotSpread(int Weapon)
 {
 	const float Charge = GetWeaponLevelCharge(Weapon);
 
@@ -1500,7 +1501,7 @@ const int GetShotSpread(int Weapon)
 	return Spread;
 }
 
-const float GetProjectileSpread(int Weapon)
+static const float CalcProjectileSpread(int Weapon)
 {
 	if (GetStaticType(Weapon) == SW_GUN1)
 		return 0.06f;
@@ -1518,7 +1519,7 @@ const float GetProjectileSpread(int Weapon)
 	return Spread;
 }
 
-const bool IsFlammableProjectile(int Weapon)
+static const bool CalcIsFlammableProjectile(int Weapon)
 {
 	if (Weapon == WEAPON_ACID)
 		return 0.0f;
@@ -1550,7 +1551,7 @@ const bool IsFlammableProjectile(int Weapon)
 	return false;
 }
 
-const float WeaponFlameAmount(int Weapon)
+static const float CalcWeaponFlameAmount(int Weapon)
 {
 	if (IsStaticWeapon(Weapon))
 	{
@@ -1594,7 +1595,7 @@ const float WeaponFlameAmount(int Weapon)
 	return 0.0f;
 }
 
-const int AIAttackRange(int Weapon)
+static const int CalcAIAttackRange(int Weapon)
 {
 	// seeing distance for free hands / no weapon
 	if (Weapon == 0)
@@ -1677,7 +1678,7 @@ const int AIAttackRange(int Weapon)
 	return 0;
 }
 
-const float WeaponElectroAmount(int Weapon)
+static const float CalcWeaponElectroAmount(int Weapon)
 {
 	if (Weapon == WEAPON_ACID)
 		return 0.0f;
@@ -1752,7 +1753,7 @@ const float WeaponElectroAmount(int Weapon)
 	return 0.0f;
 }
 
-const int WeaponBurstCount(int Weapon)
+static const int CalcWeaponBurstCount(int Weapon)
 {
 	const float Charge = GetWeaponLevelCharge(Weapon);
 
@@ -1787,7 +1788,7 @@ const int WeaponBurstCount(int Weapon)
 	return 0;
 }
 
-const float WeaponBurstReload(int Weapon)
+static const float CalcWeaponBurstReload(int Weapon)
 {
 	const float Charge = GetWeaponLevelCharge(Weapon);
 
@@ -1823,7 +1824,7 @@ const float WeaponBurstReload(int Weapon)
 	return 1.0f;
 }
 
-const float GetProjectileDamage(int Weapon)
+static const float CalcProjectileDamage(int Weapon)
 {
 	const float Charge = GetWeaponLevelCharge(Weapon);
 
@@ -1980,7 +1981,7 @@ const int GetRandomWeaponType(bool IsSurvival)
 	return w;
 }
 
-const bool WeaponAutoPick(int Weapon)
+static const bool CalcWeaponAutoPick(int Weapon)
 {
 	if (IsStaticWeapon(Weapon))
 	{
@@ -2005,7 +2006,7 @@ const bool WeaponAutoPick(int Weapon)
 	return true;
 }
 
-const float GetProjectileKnockback(int Weapon)
+static const float CalcProjectileKnockback(int Weapon)
 {
 	if (IsDroid(Weapon))
 	{
@@ -2145,7 +2146,7 @@ const float GetProjectileLife(int Weapon)
 	return v;
 }
 
-const float WeaponThrowForce(int Weapon)
+static const float CalcWeaponThrowForce(int Weapon)
 {
 	if (IsStaticWeapon(Weapon))
 	{
@@ -2173,7 +2174,7 @@ const float WeaponThrowForce(int Weapon)
 	return 0.0f;
 }
 
-const float GetWeaponFireRate(int Weapon)
+static const float CalcWeaponFireRate(int Weapon)
 {
 	// 0.0f <= Charge <= 1.0f
 	const float Charge = GetWeaponLevelCharge(Weapon);
@@ -2287,7 +2288,7 @@ const float GetWeaponFireRate(int Weapon)
 	return v;
 }
 
-const float GetWeaponKnockback(int Weapon)
+static const float CalcWeaponKnockback(int Weapon)
 {
 	if (IsModularWeapon(Weapon))
 	{
@@ -2341,7 +2342,7 @@ const float GetWeaponKnockback(int Weapon)
 	return 0.0f;
 }
 
-const bool GetWeaponFullAuto(int Weapon)
+static const bool CalcWeaponFullAuto(int Weapon)
 {
 	const float Charge = GetWeaponLevelCharge(Weapon);
 
@@ -2371,7 +2372,7 @@ const bool GetWeaponFullAuto(int Weapon)
 	return true;
 }
 
-const int IsProjectileBouncy(int Weapon)
+static const int CalcIsProjectileBouncy(int Weapon)
 {
 	if (GetStaticType(Weapon) == SW_BOUNCER)
 		return 9;
@@ -2382,12 +2383,12 @@ const int IsProjectileBouncy(int Weapon)
 	return 0;
 }
 
-const bool IsExplosiveProjectile(int Weapon)
+static const bool CalcIsExplosiveProjectile(int Weapon)
 {
 	return true;
 }
 
-const int GetWeaponMaxAmmo(int Weapon)
+static const int CalcWeaponMaxAmmo(int Weapon)
 {
 	// 0.0f <= Charge <= 1.0f
 	const float Charge = GetWeaponLevelCharge(Weapon);
@@ -2474,7 +2475,7 @@ const int GetWeaponMaxAmmo(int Weapon)
 	return 0;
 }
 
-const bool WeaponUseAmmo(int Weapon)
+static const bool CalcWeaponUseAmmo(int Weapon)
 {
 	if (IsModularWeapon(Weapon) && GetPart(Weapon, GROUP_PART1) < SW_GRENADE3)
 		return true;
@@ -2502,3 +2503,91 @@ const bool WeaponUseAmmo(int Weapon)
 
 	return false;
 }
+
+// the table maps each 16 bit weapon int to one of the distinct property sets
+enum
+{
+	NUM_TABLED_WEAPONS=1<<16,
+	WEAPONTABLE_HASHSIZE=1<<17,
+};
+
+static CWeaponProperties *s_pWeaponProperties = 0;
+static unsigned short *s_pWeaponIndex = 0;
+static bool s_WeaponTableBuilding = false;
+
+static unsigned HashWeaponProperties(const CWeaponProperties *pProps)
+{
+	const unsigned char *pData = (const unsigned char *)pProps;
+	unsigned Hash = 2166136261u;
+	for(unsigned i = 0; i < sizeof(*pProps); i++)
+		Hash = (Hash^pData[i])*16777619u;
+	return Hash;
+}
+
+void InitWeaponProperties()
+{
+	if(s_pWeaponIndex || s_WeaponTableBuilding)
+		return;
+
+	// the calc functions look up other properties, they get computed
+	// directly while building
+	s_WeaponTableBuilding = true;
+
+	int64 StartTime = time_get();
+	CWeaponProperties *pProperties = (CWeaponProperties *)mem_alloc(sizeof(CWeaponProperties)*NUM_TABLED_WEAPONS, 1);
+	unsigned short *pIndex = (unsigned short *)mem_alloc(sizeof(unsigned short)*NUM_TABLED_WEAPONS, 1);
+	int *pHash = (int *)mem_alloc(sizeof(int)*WEAPONTABLE_HASHSIZE, 1);
+	for(int i = 0; i < WEAPONTABLE_HASHSIZE; i++)
+		pHash[i] = -1;
+
+	int NumProperties = 0;
+	for(int Weapon = 0; Weapon < NUM_TABLED_WEAPONS; Weapon++)
+	{
+		// zeroed first so the padding compares equal
+		CWeaponProperties *pProps = &pProperties[NumProperties];
+		mem_zero(pProps, sizeof(*pProps));
+#define MACRO_WEAPON_PROPERTY(Type, Name, Function) pProps->m_##Name = Calc##Name(Weapon);
+#include "weaponprops.h"
+#undef MACRO_WEAPON_PROPERTY
+
+		unsigned Slot = HashWeaponProperties(pProps)&(WEAPONTABLE_HASHSIZE-1);
+		while(pHash[Slot] != -1 && mem_comp(&pProperties[pHash[Slot]], pProps, sizeof(*pProps)) != 0)
+			Slot = (Slot+1)&(WEAPONTABLE_HASHSIZE-1);
+
+		if(pHash[Slot] == -1)
+			pHash[Slot] = NumProperties++;
+		pIndex[Weapon] = pHash[Slot];
+	}
+
+	mem_free(pHash);
+
+	// keep only the distinct sets
+	s_pWeaponProperties = (CWeaponProperties *)mem_alloc(sizeof(CWeaponProperties)*NumProperties, 1);
+	mem_copy(s_pWeaponProperties, pProperties, sizeof(CWeaponProperties)*NumProperties);
+	mem_free(pProperties);
+	s_pWeaponIndex = pIndex;
+
+	s_WeaponTableBuilding = false;
+
+	dbg_msg("weapons", "built weapon table, %d distinct property sets, %.2fms", NumProperties, (time_get()-StartTime)*1000.0/time_freq());
+}
+
+const CWeaponProperties *GetWeaponProperties(int Weapon)
+{
+	if(Weapon < 0 || Weapon >= NUM_TABLED_WEAPONS || s_WeaponTableBuilding)
+		return 0;
+
+	if(!s_pWeaponIndex)
+		InitWeaponProperties();
+
+	return &s_pWeaponProperties[s_pWeaponIndex[Weapon]];
+}
+
+#define MACRO_WEAPON_PROPERTY(Type, Name, Function) \
+	const Type Function(int Weapon) \
+	{ \
+		const CWeaponProperties *pProps = GetWeaponProperties(Weapon); \
+		return pProps ? pProps->m_##Name : Calc##Name(Weapon); \
+	}
+#include "weaponprops.h"
+#undef MACRO_WEAPON_PROPERTY
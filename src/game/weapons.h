@@ -199,6 +199,19 @@ inline const int GetDroidWeapon(int Droid, bool OnDeath = false)
 	return BIT_DROID | (OnDeath ? BIT_ONDEATH : 0) | Droid << 6;
 }
 
+// all the properties below of one weapon int, weapon ints within 16 bits
+// share a table built by InitWeaponProperties or on the first lookup,
+// 0 for the others
+struct CWeaponProperties
+{
+#define MACRO_WEAPON_PROPERTY(Type, Name, Function) Type m_##Name;
+#include "weaponprops.h"
+#undef MACRO_WEAPON_PROPERTY
+};
+
+void InitWeaponProperties();
+const CWeaponProperties *GetWeaponProperties(int Weapon);
+
 const bool ValidForTurret(int Weapon);
 
 const int GetShotSpread(int Weapon);
@@ -19,7 +19,67 @@ enum {
 	MAX_SERVERS_PER_PACKET=75,
 	MAX_PACKETS=256,
 	MAX_SERVERS=MAX_SERVERS_PER_PACKET*MAX_PACKETS,
-	EXPIRE_TIME = 90
+	EXPIRE_TIME = 90,
+	HASH_SIZE = 1<<14
+};
+
+// maps addresses to slots of the tables below
+template<int MAX_NODES>
+class CAddrIndex
+{
+	struct CNode
+	{
+		NETADDR m_Addr;
+		int m_Next;
+	};
+
+	int m_aBuckets[HASH_SIZE];
+	CNode m_aNodes[MAX_NODES];
+
+	static int Hash(const NETADDR *pAddr)
+	{
+		// same bytes as net_addr_comp looks at
+		const unsigned char *pData = (const unsigned char *)pAddr;
+		unsigned Hash = 2166136261u;
+		for(unsigned i = 0; i < sizeof(NETADDR); i++)
+			Hash = (Hash^pData[i])*16777619u;
+		return Hash&(HASH_SIZE-1);
+	}
+
+public:
+	CAddrIndex()
+	{
+		for(int i = 0; i < HASH_SIZE; i++)
+			m_aBuckets[i] = -1;
+	}
+
+	void Insert(int Node, const NETADDR *pAddr)
+	{
+		int Bucket = Hash(pAddr);
+		m_aNodes[Node].m_Addr = *pAddr;
+		m_aNodes[Node].m_Next = m_aBuckets[Bucket];
+		m_aBuckets[Bucket] = Node;
+	}
+
+	void Remove(int Node)
+	{
+		for(int *pLink = &m_aBuckets[Hash(&m_aNodes[Node].m_Addr)]; *pLink != -1; pLink = &m_aNodes[*pLink].m_Next)
+		{
+			if(*pLink == Node)
+			{
+				*pLink = m_aNodes[Node].m_Next;
+				return;
+			}
+		}
+	}
+
+	int Find(const NETADDR *pAddr) const
+	{
+		for(int Node = m_aBuckets[Hash(pAddr)]; Node != -1; Node = m_aNodes[Node].m_Next)
+			if(net_addr_comp(&m_aNodes[Node].m_Addr, pAddr) == 0)
+				return Node;
+		return -1;
+	}
 };
 
 struct CCheckServer
@@ -33,16 +93,28 @@ struct CCheckServer
 
 static CCheckServer m_aCheckServers[MAX_SERVERS];
 static int m_NumCheckServers = 0;
+// node Slot*2 is the address, Slot*2+1 the alternative address
+static CAddrIndex<MAX_SERVERS*2> m_CheckServerIndex;
 
 struct CServerEntry
 {
 	enum ServerType m_Type;
 	NETADDR m_Address;
 	int64 m_Expire;
+
+	// position in the list packets of its type
+	int m_ListPos;
+
+	// neighbours in expire order
+	int m_ExpirePrev;
+	int m_ExpireNext;
 };
 
 static CServerEntry m_aServers[MAX_SERVERS];
 static int m_NumServers = 0;
+static CAddrIndex<MAX_SERVERS> m_ServerIndex;
+static int m_FirstExpire = -1;
+static int m_LastExpire = -1;
 
 struct CPacketData
 {
@@ -69,6 +141,12 @@ struct CPacketDataLegacy
 CPacketDataLegacy m_aPacketsLegacy[MAX_PACKETS];
 static int m_NumPacketsLegacy = 0;
 
+// server slots in list order, one list per server type
+static int m_aListServers[MAX_SERVERS];
+static int m_NumListServers = 0;
+static int m_aListServersLegacy[MAX_SERVERS];
+static int m_NumListServersLegacy = 0;
+
 
 struct CCountPacketData
 {
@@ -88,83 +166,155 @@ static CNetClient m_NetOp; // main
 
 IConsole *m_pConsole;
 
-void BuildPackets()
+void InitPackets()
+{
+	for(int i = 0; i < MAX_PACKETS; i++)
+	{
+		mem_copy(m_aPackets[i].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+		mem_copy(m_aPacketsLegacy[i].m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
+	}
+}
+
+void WriteListEntry(int Type, int Pos, const NETADDR *pAddr)
 {
-	CServerEntry *pCurrent = &m_aServers[0];
-	int ServersLeft = m_NumServers;
-	m_NumPackets = 0;
-	m_NumPacketsLegacy = 0;
-	int PacketIndex = 0;
-	int PacketIndexLegacy = 0;
-	while(ServersLeft-- && (m_NumPackets + m_NumPacketsLegacy) < MAX_PACKETS)
+	if(Type == SERVERTYPE_NORMAL)
 	{
-		if(pCurrent->m_Type == SERVERTYPE_NORMAL)
+		CMastersrvAddr *pEntry = &m_aPackets[Pos/MAX_SERVERS_PER_PACKET].m_Data.m_aServers[Pos%MAX_SERVERS_PER_PACKET];
+
+		// copy server addresses
+		if(pAddr->type == NETTYPE_IPV6)
 		{
-			if(PacketIndex % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndex = 0;
-				m_NumPackets++;
-			}
+			mem_copy(pEntry->m_aIp, pAddr->ip, sizeof(pEntry->m_aIp));
+		}
+		else
+		{
+			static unsigned char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF };
 
-			// copy header
-			mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+			mem_copy(pEntry->m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
+			pEntry->m_aIp[12] = pAddr->ip[0];
+			pEntry->m_aIp[13] = pAddr->ip[1];
+			pEntry->m_aIp[14] = pAddr->ip[2];
+			pEntry->m_aIp[15] = pAddr->ip[3];
+		}
 
-			// copy server addresses
-			if(pCurrent->m_Address.type == NETTYPE_IPV6)
-			{
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, pCurrent->m_Address.ip,
-					sizeof(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp));
-			}
-			else
-			{
-				static unsigned char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF };
+		pEntry->m_aPort[0] = (pAddr->port>>8)&0xff;
+		pEntry->m_aPort[1] = pAddr->port&0xff;
+	}
+	else
+	{
+		CMastersrvAddrLegacy *pEntry = &m_aPacketsLegacy[Pos/MAX_SERVERS_PER_PACKET].m_Data.m_aServers[Pos%MAX_SERVERS_PER_PACKET];
 
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[12] = pCurrent->m_Address.ip[0];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[13] = pCurrent->m_Address.ip[1];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[14] = pCurrent->m_Address.ip[2];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[15] = pCurrent->m_Address.ip[3];
-			}
+		// copy server addresses
+		mem_copy(pEntry->m_aIp, pAddr->ip, sizeof(pEntry->m_aIp));
+		// 0.5 has the port in little endian on the network
+		pEntry->m_aPort[0] = pAddr->port&0xff;
+		pEntry->m_aPort[1] = (pAddr->port>>8)&0xff;
+	}
+}
 
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[0] = (pCurrent->m_Address.port>>8)&0xff;
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[1] = pCurrent->m_Address.port&0xff;
+void UpdatePacketSizes(int Type)
+{
+	// only the last two packets can change size when a server is added or removed
+	int NumServers = Type == SERVERTYPE_NORMAL ? m_NumListServers : m_NumListServersLegacy;
+	int NumPackets = (NumServers+MAX_SERVERS_PER_PACKET-1)/MAX_SERVERS_PER_PACKET;
+	int Last = NumServers-(NumPackets-1)*MAX_SERVERS_PER_PACKET;
 
-			PacketIndex++;
+	if(Type == SERVERTYPE_NORMAL)
+	{
+		m_NumPackets = NumPackets;
+		if(NumPackets > 1)
+			m_aPackets[NumPackets-2].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*MAX_SERVERS_PER_PACKET;
+		if(NumPackets > 0)
+			m_aPackets[NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*Last;
+	}
+	else
+	{
+		m_NumPacketsLegacy = NumPackets;
+		if(NumPackets > 1)
+			m_aPacketsLegacy[NumPackets-2].m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*MAX_SERVERS_PER_PACKET;
+		if(NumPackets > 0)
+			m_aPacketsLegacy[NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*Last;
+	}
+}
 
-			m_aPackets[m_NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*PacketIndex;
+void ListAdd(int Slot)
+{
+	CServerEntry *pServer = &m_aServers[Slot];
+	int *pList = pServer->m_Type == SERVERTYPE_NORMAL ? m_aListServers : m_aListServersLegacy;
+	int *pNum = pServer->m_Type == SERVERTYPE_NORMAL ? &m_NumListServers : &m_NumListServersLegacy;
+
+	pServer->m_ListPos = (*pNum)++;
+	pList[pServer->m_ListPos] = Slot;
+	WriteListEntry(pServer->m_Type, pServer->m_ListPos, &pServer->m_Address);
+	UpdatePacketSizes(pServer->m_Type);
+}
 
-			pCurrent++;
-		}
-		else if(pCurrent->m_Type == SERVERTYPE_LEGACY)
-		{
-			if(PacketIndexLegacy % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndexLegacy = 0;
-				m_NumPacketsLegacy++;
-			}
+void ListRemove(int Slot)
+{
+	// fill the gap with the last server of the list
+	CServerEntry *pServer = &m_aServers[Slot];
+	int *pList = pServer->m_Type == SERVERTYPE_NORMAL ? m_aListServers : m_aListServersLegacy;
+	int *pNum = pServer->m_Type == SERVERTYPE_NORMAL ? &m_NumListServers : &m_NumListServersLegacy;
 
-			// copy header
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
+	int Moved = pList[--(*pNum)];
+	if(Moved != Slot)
+	{
+		m_aServers[Moved].m_ListPos = pServer->m_ListPos;
+		pList[pServer->m_ListPos] = Moved;
+		WriteListEntry(pServer->m_Type, pServer->m_ListPos, &m_aServers[Moved].m_Address);
+	}
+	UpdatePacketSizes(pServer->m_Type);
+}
 
-			// copy server addresses
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp, pCurrent->m_Address.ip,
-				sizeof(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp));
-			// 0.5 has the port in little endian on the network
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[0] = pCurrent->m_Address.port&0xff;
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[1] = (pCurrent->m_Address.port>>8)&0xff;
+void ExpireUnlink(int Slot)
+{
+	CServerEntry *pServer = &m_aServers[Slot];
+	if(pServer->m_ExpirePrev != -1)
+		m_aServers[pServer->m_ExpirePrev].m_ExpireNext = pServer->m_ExpireNext;
+	else
+		m_FirstExpire = pServer->m_ExpireNext;
+	if(pServer->m_ExpireNext != -1)
+		m_aServers[pServer->m_ExpireNext].m_ExpirePrev = pServer->m_ExpirePrev;
+	else
+		m_LastExpire = pServer->m_ExpirePrev;
+}
 
-			PacketIndexLegacy++;
+void ExpireAppend(int Slot)
+{
+	// every server gets the same expire time, so appending keeps the list sorted
+	CServerEntry *pServer = &m_aServers[Slot];
+	pServer->m_ExpirePrev = m_LastExpire;
+	pServer->m_ExpireNext = -1;
+	if(m_LastExpire != -1)
+		m_aServers[m_LastExpire].m_ExpireNext = Slot;
+	else
+		m_FirstExpire = Slot;
+	m_LastExpire = Slot;
+}
 
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*PacketIndexLegacy;
+void RemoveServer(int Slot)
+{
+	ListRemove(Slot);
+	ExpireUnlink(Slot);
+	m_ServerIndex.Remove(Slot);
 
-			pCurrent++;
-		}
+	// move the last server into the free slot
+	int Last = --m_NumServers;
+	if(Last != Slot)
+	{
+		CServerEntry *pServer = &m_aServers[Last];
+		m_ServerIndex.Remove(Last);
+		m_ServerIndex.Insert(Slot, &pServer->m_Address);
+		(pServer->m_Type == SERVERTYPE_NORMAL ? m_aListServers : m_aListServersLegacy)[pServer->m_ListPos] = Slot;
+		if(pServer->m_ExpirePrev != -1)
+			m_aServers[pServer->m_ExpirePrev].m_ExpireNext = Slot;
 		else
-		{
-			*pCurrent = m_aServers[m_NumServers-1];
-			m_NumServers--;
-			dbg_msg("mastersrv", "error: server of invalid type, dropping it");
-		}
+			m_FirstExpire = Slot;
+		if(pServer->m_ExpireNext != -1)
+			m_aServers[pServer->m_ExpireNext].m_ExpirePrev = Slot;
+		else
+			m_LastExpire = Slot;
+		m_aServers[Slot] = *pServer;
 	}
 }
 
@@ -206,6 +356,10 @@ void SendCheck(NETADDR *pAddr)
 
 void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type)
 {
+	// already being checked
+	if(m_CheckServerIndex.Find(pInfo) != -1)
+		return;
+
 	// add server
 	if(m_NumCheckServers == MAX_SERVERS)
 	{
@@ -223,22 +377,47 @@ void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type)
 	m_aCheckServers[m_NumCheckServers].m_TryCount = 0;
 	m_aCheckServers[m_NumCheckServers].m_TryTime = 0;
 	m_aCheckServers[m_NumCheckServers].m_Type = Type;
+	m_CheckServerIndex.Insert(m_NumCheckServers*2, pInfo);
+	m_CheckServerIndex.Insert(m_NumCheckServers*2+1, pAlt);
 	m_NumCheckServers++;
 }
 
+void RemoveCheckserver(int Slot)
+{
+	m_CheckServerIndex.Remove(Slot*2);
+	m_CheckServerIndex.Remove(Slot*2+1);
+
+	// move the last one into the free slot
+	int Last = --m_NumCheckServers;
+	if(Last != Slot)
+	{
+		m_CheckServerIndex.Remove(Last*2);
+		m_CheckServerIndex.Remove(Last*2+1);
+		m_aCheckServers[Slot] = m_aCheckServers[Last];
+		m_CheckServerIndex.Insert(Slot*2, &m_aCheckServers[Slot].m_Address);
+		m_CheckServerIndex.Insert(Slot*2+1, &m_aCheckServers[Slot].m_AltAddress);
+	}
+}
+
 void AddServer(NETADDR *pInfo, ServerType Type)
 {
 	// see if server already exists in list
-	for(int i = 0; i < m_NumServers; i++)
+	int Slot = m_ServerIndex.Find(pInfo);
+	if(Slot != -1)
 	{
-		if(net_addr_comp(&m_aServers[i].m_Address, pInfo) == 0)
-		{
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "updated: %s", aAddrStr);
-			m_aServers[i].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-			return;
-		}
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
+		dbg_msg("mastersrv", "updated: %s", aAddrStr);
+		m_aServers[Slot].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+		ExpireUnlink(Slot);
+		ExpireAppend(Slot);
+		return;
+	}
+
+	if(Type != SERVERTYPE_NORMAL && Type != SERVERTYPE_LEGACY)
+	{
+		dbg_msg("mastersrv", "error: server of invalid type, dropping it");
+		return;
 	}
 
 	// add server
@@ -251,10 +430,13 @@ void AddServer(NETADDR *pInfo, ServerType Type)
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	dbg_msg("mastersrv", "added: %s", aAddrStr);
-	m_aServers[m_NumServers].m_Address = *pInfo;
-	m_aServers[m_NumServers].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-	m_aServers[m_NumServers].m_Type = Type;
-	m_NumServers++;
+	Slot = m_NumServers++;
+	m_aServers[Slot].m_Address = *pInfo;
+	m_aServers[Slot].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+	m_aServers[Slot].m_Type = Type;
+	m_ServerIndex.Insert(Slot, pInfo);
+	ListAdd(Slot);
+	ExpireAppend(Slot);
 }
 
 void UpdateServers()
@@ -275,8 +457,7 @@ void UpdateServers()
 
 				// FAIL!!
 				SendError(&m_aCheckServers[i].m_Address);
-				m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers-1];
-				m_NumCheckServers--;
+				RemoveCheckserver(i);
 				i--;
 			}
 			else
@@ -294,21 +475,15 @@ void UpdateServers()
 
 void PurgeServers()
 {
+	// the expire list is sorted, so stop at the first server still alive
 	int64 Now = time_get();
-	int i = 0;
-	while(i < m_NumServers)
+	while(m_FirstExpire != -1 && m_aServers[m_FirstExpire].m_Expire < Now)
 	{
-		if(m_aServers[i].m_Expire < Now)
-		{
-			// remove server
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(&m_aServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "expired: %s", aAddrStr);
-			m_aServers[i] = m_aServers[m_NumServers-1];
-			m_NumServers--;
-		}
-		else
-			i++;
+		// remove server
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(&m_aServers[m_FirstExpire].m_Address, aAddrStr, sizeof(aAddrStr), true);
+		dbg_msg("mastersrv", "expired: %s", aAddrStr);
+		RemoveServer(m_FirstExpire);
 	}
 }
 
@@ -329,6 +504,7 @@ int main(int argc, const char **argv) // ignore_convention
 
 	mem_copy(m_CountData.m_Header, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT));
 	mem_copy(m_CountDataLegacy.m_Header, SERVERBROWSE_COUNT_LEGACY, sizeof(SERVERBROWSE_COUNT_LEGACY));
+	InitPackets();
 
 	IKernel *pKernel = IKernel::Create();
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
@@ -495,24 +671,15 @@ int main(int argc, const char **argv) // ignore_convention
 			if(Packet.m_DataSize == sizeof(SERVERBROWSE_FWRESPONSE) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_FWRESPONSE, sizeof(SERVERBROWSE_FWRESPONSE)) == 0)
 			{
-				Type = SERVERTYPE_INVALID;
-				// remove it from checking
-				for(int i = 0; i < m_NumCheckServers; i++)
-				{
-					if(net_addr_comp(&m_aCheckServers[i].m_Address, &Packet.m_Address) == 0 ||
-						net_addr_comp(&m_aCheckServers[i].m_AltAddress, &Packet.m_Address) == 0)
-					{
-						Type = m_aCheckServers[i].m_Type;
-						m_NumCheckServers--;
-						m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers];
-						break;
-					}
-				}
-
 				// drops servers that were not in the CheckServers list
-				if(Type == SERVERTYPE_INVALID)
+				int Node = m_CheckServerIndex.Find(&Packet.m_Address);
+				if(Node == -1)
 					continue;
 
+				// remove it from checking
+				Type = m_aCheckServers[Node/2].m_Type;
+				RemoveCheckserver(Node/2);
+
 				AddServer(&Packet.m_Address, Type);
 				SendOk(&Packet.m_Address);
 			}
@@ -531,7 +698,6 @@ int main(int argc, const char **argv) // ignore_convention
 
 			PurgeServers();
 			UpdateServers();
-			BuildPackets();
 		}
 
 		// be nice to the CPU
@@ -12,6 +12,7 @@
 CLocalization::CLanguage::CLanguage() :
 	m_Loaded(false),
 	m_Direction(CLocalization::DIRECTION_LTR),
+	m_Parent(-1),
 	m_pPluralRules(NULL),
 	m_pNumberFormater(NULL),
 	m_pPercentFormater(NULL),
@@ -25,6 +26,7 @@ CLocalization::CLanguage::CLanguage() :
 CLocalization::CLanguage::CLanguage(const char* pName, const char* pFilename, const char* pParentFilename) :
 	m_Loaded(false),
 	m_Direction(CLocalization::DIRECTION_LTR),
+	m_Parent(-1),
 	m_pPluralRules(NULL),
 	m_pNumberFormater(NULL),
 	m_pPercentFormater(NULL)
@@ -93,6 +95,15 @@ CLocalization::CLanguage::~CLanguage()
 		++Iter;
 	}
 	
+	hashtable< CMessage, 128 >::iterator MsgIter = m_Messages.begin();
+	while(MsgIter != m_Messages.end())
+	{
+		if(MsgIter.data())
+			MsgIter.data()->Free();
+		
+		++MsgIter;
+	}
+	
 	if(m_pNumberFormater)
 		unum_close(m_pNumberFormater);
 	
@@ -267,6 +278,26 @@ const char* CLocalization::CLanguage::Localize_P(int Number, const char* pText)
 	return pEntry->m_apVersions[PluralCode];
 }
 
+const char* CLocalization::CLanguage::GetMessage(const char* pText) const
+{
+	const CMessage* pMessage = m_Messages.get(pText);
+	if(!pMessage)
+		return NULL;
+	
+	return pMessage->m_pText;
+}
+
+void CLocalization::CLanguage::SetMessage(const char* pText, const char* pMessage)
+{
+	CMessage* pEntry = m_Messages.set(pText);
+	if(pEntry->m_pText)
+		return;
+	
+	int Length = str_length(pMessage)+1;
+	pEntry->m_pText = new char[Length];
+	str_copy(pEntry->m_pText, pMessage, Length);
+}
+
 /* LOCALIZATION *******************************************************/
 
 /* BEGIN EDIT *********************************************************/
@@ -356,6 +387,13 @@ bool CLocalization::Init()
 		}
 	}
 
+	// resolve the parents once, unknown parents fall back to the main language
+	for(int i=0; i<m_pLanguages.size(); i++)
+	{
+		if(m_pLanguages[i]->GetParentFilename()[0])
+			m_pLanguages[i]->SetParent(GetLanguageHandle(m_pLanguages[i]->GetParentFilename()));
+	}
+
 	// clean up
 	json_value_free(pJsonData);
 	delete[] pFileData;
@@ -577,21 +615,23 @@ const char *CLocalization::FallbackLanguageForIpCountryCode(int Country)
 	}
 }
 
-const char* CLocalization::LocalizeWithDepth(const char* pLanguageCode, const char* pText, int Depth)
+int CLocalization::GetLanguageHandle(const char* pLanguageCode) const
 {
-	CLanguage* pLanguage = m_pMainLanguage;
 	if(pLanguageCode)
 	{
 		for(int i=0; i<m_pLanguages.size(); i++)
 		{
 			if(str_comp(m_pLanguages[i]->GetFilename(), pLanguageCode) == 0)
-			{
-				pLanguage = m_pLanguages[i];
-				break;
-			}
+				return i;
 		}
 	}
 	
+	return -1;
+}
+
+const char* CLocalization::LocalizeWithDepth(int Language, const char* pText, int Depth)
+{
+	CLanguage* pLanguage = GetLanguage(Language);
 	if(!pLanguage)
 		return pText;
 	
@@ -602,31 +642,24 @@ const char* CLocalization::LocalizeWithDepth(const char* pLanguageCode, const ch
 	if(pResult)
 		return pResult;
 	else if(pLanguage->GetParentFilename()[0] && Depth < 4)
-		return LocalizeWithDepth(pLanguage->GetParentFilename(), pText, Depth+1);
+		return LocalizeWithDepth(pLanguage->GetParent(), pText, Depth+1);
 	else
 		return pText;
 }
 
+const char* CLocalization::Localize(int Language, const char* pText)
+{
+	return LocalizeWithDepth(Language, pText, 0);
+}
+
 const char* CLocalization::Localize(const char* pLanguageCode, const char* pText)
 {
-	return LocalizeWithDepth(pLanguageCode, pText, 0);
+	return LocalizeWithDepth(GetLanguageHandle(pLanguageCode), pText, 0);
 }
 
-const char* CLocalization::LocalizeWithDepth_P(const char* pLanguageCode, int Number, const char* pText, int Depth)
+const char* CLocalization::LocalizeWithDepth_P(int Language, int Number, const char* pText, int Depth)
 {
-	CLanguage* pLanguage = m_pMainLanguage;
-	if(pLanguageCode)
-	{
-		for(int i=0; i<m_pLanguages.size(); i++)
-		{
-			if(str_comp(m_pLanguages[i]->GetFilename(), pLanguageCode) == 0)
-			{
-				pLanguage = m_pLanguages[i];
-				break;
-			}
-		}
-	}
-	
+	CLanguage* pLanguage = GetLanguage(Language);
 	if(!pLanguage)
 		return pText;
 	
@@ -637,14 +670,19 @@ const char* CLocalization::LocalizeWithDepth_P(const char* pLanguageCode, int Nu
 	if(pResult)
 		return pResult;
 	else if(pLanguage->GetParentFilename()[0] && Depth < 4)
-		return LocalizeWithDepth_P(pLanguage->GetParentFilename(), Number, pText, Depth+1);
+		return LocalizeWithDepth_P(pLanguage->GetParent(), Number, pText, Depth+1);
 	else
 		return pText;
 }
 
+const char* CLocalization::Localize_P(int Language, int Number, const char* pText)
+{
+	return LocalizeWithDepth_P(Language, Number, pText, 0);
+}
+
 const char* CLocalization::Localize_P(const char* pLanguageCode, int Number, const char* pText)
 {
-	return LocalizeWithDepth_P(pLanguageCode, Number, pText, 0);
+	return LocalizeWithDepth_P(GetLanguageHandle(pLanguageCode), Number, pText, 0);
 }
 
 void CLocalization::AppendNumber(dynamic_string& Buffer, int& BufferIter, CLanguage* pLanguage, int Number)
@@ -729,20 +767,9 @@ void CLocalization::AppendDuration(dynamic_string& Buffer, int& BufferIter, CLan
 	}
 }
 
-void CLocalization::Format_V(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, va_list VarArgs)
+void CLocalization::Format_V(dynamic_string& Buffer, int Language, const char* pText, va_list VarArgs)
 {
-	CLanguage* pLanguage = m_pMainLanguage;	
-	if(pLanguageCode)
-	{
-		for(int i=0; i<m_pLanguages.size(); i++)
-		{
-			if(str_comp(m_pLanguages[i]->GetFilename(), pLanguageCode) == 0)
-			{
-				pLanguage = m_pLanguages[i];
-				break;
-			}
-		}
-	}
+	CLanguage* pLanguage = GetLanguage(Language);
 	if(!pLanguage)
 	{
 		Buffer.append(pText);
@@ -880,6 +907,11 @@ void CLocalization::Format_V(dynamic_string& Buffer, const char* pLanguageCode,
 		ArabicShaping(Buffer, BufferStart);
 }
 
+void CLocalization::Format_V(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, va_list VarArgs)
+{
+	Format_V(Buffer, GetLanguageHandle(pLanguageCode), pText, VarArgs);
+}
+
 void CLocalization::Format(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, ...)
 {
 	va_list VarArgs;
@@ -890,11 +922,43 @@ void CLocalization::Format(dynamic_string& Buffer, const char* pLanguageCode, co
 	va_end(VarArgs);
 }
 
+void CLocalization::Format_VL(dynamic_string& Buffer, int Language, const char* pText, va_list VarArgs)
+{
+	CLanguage* pLanguage = GetLanguage(Language);
+	if(pLanguage)
+	{
+		const char* pMessage = pLanguage->GetMessage(pText);
+		if(pMessage)
+		{
+			Buffer.append(pMessage);
+			return;
+		}
+	}
+	
+	int BufferStart = Buffer.length();
+	const char* pLocalText = Localize(Language, pText);
+	
+	Format_V(Buffer, Language, pLocalText, VarArgs);
+	
+	//without any macro the result doesn't depend on the arguments, keep it.
+	//only translated texts, runtime-built ones have no key and would grow the cache forever
+	if(pLanguage && pLocalText != pText && !str_find(pLocalText, "{"))
+		pLanguage->SetMessage(pText, Buffer.buffer()+BufferStart);
+}
+
 void CLocalization::Format_VL(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, va_list VarArgs)
 {
-	const char* pLocalText = Localize(pLanguageCode, pText);
+	Format_VL(Buffer, GetLanguageHandle(pLanguageCode), pText, VarArgs);
+}
+
+void CLocalization::Format_L(dynamic_string& Buffer, int Language, const char* pText, ...)
+{
+	va_list VarArgs;
+	va_start(VarArgs, pText);
 	
-	Format_V(Buffer, pLanguageCode, pLocalText, VarArgs);
+	Format_VL(Buffer, Language, pText, VarArgs);
+	
+	va_end(VarArgs);
 }
 
 void CLocalization::Format_L(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, ...)
@@ -909,9 +973,10 @@ void CLocalization::Format_L(dynamic_string& Buffer, const char* pLanguageCode,
 
 void CLocalization::Format_VLP(dynamic_string& Buffer, const char* pLanguageCode, int Number, const char* pText, va_list VarArgs)
 {
-	const char* pLocalText = Localize_P(pLanguageCode, Number, pText);
+	int Language = GetLanguageHandle(pLanguageCode);
+	const char* pLocalText = Localize_P(Language, Number, pText);
 	
-	Format_V(Buffer, pLanguageCode, pLocalText, VarArgs);
+	Format_V(Buffer, Language, pLocalText, VarArgs);
 }
 
 void CLocalization::Format_LP(dynamic_string& Buffer, const char* pLanguageCode, int Number, const char* pText, ...)
@@ -78,14 +78,34 @@ public:
 			}
 		};
 		
+		class CMessage
+		{
+		public:
+			char* m_pText;
+			
+			CMessage() :
+				m_pText(NULL)
+			{ }
+			
+			void Free()
+			{
+				if(m_pText)
+					delete[] m_pText;
+			}
+		};
+		
 	protected:
 		char m_aName[64];
 		char m_aFilename[64];
 		char m_aParentFilename[64];
 		bool m_Loaded;
 		int m_Direction;
+		int m_Parent;
 		
 		hashtable< CEntry, 128 > m_Translations;
+		
+		//formatted messages without macros, by source text
+		hashtable< CMessage, 128 > m_Messages;
 	
 	public:
 		UPluralRules* m_pPluralRules;
@@ -103,10 +123,14 @@ public:
 		inline const char* GetName() const { return m_aName; }
 		inline int GetWritingDirection() const { return m_Direction; }
 		inline void SetWritingDirection(int Direction) { m_Direction = Direction; }
+		inline int GetParent() const { return m_Parent; }
+		inline void SetParent(int Parent) { m_Parent = Parent; }
 		inline bool IsLoaded() const { return m_Loaded; }
 		bool Load(CLocalization* pLocalization, class CStorage* pStorage);
 		const char* Localize(const char* pKey) const;
 		const char* Localize_P(int Number, const char* pText) const;
+		const char* GetMessage(const char* pText) const;
+		void SetMessage(const char* pText, const char* pMessage);
 	};
 	
 	enum
@@ -128,8 +152,10 @@ public:
 	fixed_string128 m_Cfg_MainLanguage;
 
 protected:
-	const char* LocalizeWithDepth(const char* pLanguageCode, const char* pText, int Depth);
-	const char* LocalizeWithDepth_P(const char* pLanguageCode, int Number, const char* pText, int Depth);
+	const char* LocalizeWithDepth(int Language, const char* pText, int Depth);
+	const char* LocalizeWithDepth_P(int Language, int Number, const char* pText, int Depth);
+	
+	inline CLanguage* GetLanguage(int Language) { return (Language >= 0 && Language < m_pLanguages.size() ? m_pLanguages[Language] : m_pMainLanguage); }
 	
 	void AppendNumber(dynamic_string& Buffer, int& BufferIter, CLanguage* pLanguage, int Number);
 	void AppendPercent(dynamic_string& Buffer, int& BufferIter, CLanguage* pLanguage, double Number);
@@ -152,16 +178,24 @@ public:
 	
 	inline bool GetWritingDirection() const { return (!m_pMainLanguage ? DIRECTION_LTR : m_pMainLanguage->GetWritingDirection()); }
 	
+	//handle of a language code, -1 (the main language) for unknown codes
+	int GetLanguageHandle(const char* pLanguageCode) const;
+	
 	//localize
+	const char* Localize(int Language, const char* pText);
 	const char* Localize(const char* pLanguageCode, const char* pText);
 	//localize and find the appropriate plural form based on Number
+	const char* Localize_P(int Language, int Number, const char* pText);
 	const char* Localize_P(const char* pLanguageCode, int Number, const char* pText);
 	
 	//format
+	void Format_V(dynamic_string& Buffer, int Language, const char* pText, va_list VarArgs);
 	void Format_V(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, va_list VarArgs);
 	void Format(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, ...);
 	//localize, format
+	void Format_VL(dynamic_string& Buffer, int Language, const char* pText, va_list VarArgs);
 	void Format_VL(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, va_list VarArgs);
+	void Format_L(dynamic_string& Buffer, int Language, const char* pText, ...);
 	void Format_L(dynamic_string& Buffer, const char* pLanguageCode, const char* pText, ...);
 	//localize, find the appropriate plural form based on Number and format
 	void Format_VLP(dynamic_string& Buffer, const char* pLanguageCode, int Number, const char* pText, va_list VarArgs);